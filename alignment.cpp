@@ -63,6 +63,7 @@ Alignment::Alignment()
     seq_type = SEQ_UNKNOWN;
     STATE_UNKNOWN = 126;
     pars_lower_bound = NULL;
+    num_parsimony_sites = 0;
 }
 
 string &Alignment::getSeqName(int i) {
@@ -336,6 +337,7 @@ Alignment::Alignment(char *filename, char *sequence_type, InputType &intype) : v
     seq_type = SEQ_UNKNOWN;
     STATE_UNKNOWN = 126;
     pars_lower_bound = NULL;
+    num_parsimony_sites = 0;
     cout << "Reading alignment file " << filename << " ... ";
     intype = detectInputFile(filename);
 
@@ -773,33 +775,83 @@ void Alignment::addConstPatterns(char *freq_const_patterns) {
 
 void Alignment::orderPatternByNumChars() {
     int nptn = getNPattern();
-    int ptn, site, i = 0;
+    int ptn, site, i = 0, k;
     int *num_chars = new int[nptn];
     int *ptn_order = new int[nptn];
     const int UINT_BITS = sizeof(UINT)*8;
-    int maxi = (num_informative_sites+UINT_BITS-1)/UINT_BITS;
-    pars_lower_bound = new UINT[maxi+1];
-    UINT sum = 0;
-    memset(pars_lower_bound, 0, (maxi+1)*sizeof(UINT));
+    const int MAX_CLASS = sizeof(int)*8-1;
     for (ptn = 0; ptn < nptn; ptn++) {
         num_chars[ptn] =  -at(ptn).num_chars + (!at(ptn).isInformative())*1024;
         ptn_order[ptn] = ptn;
     }
     quicksort(num_chars, 0, nptn-1, ptn_order);
+    int ninf = 0;
+    while (ninf < nptn && at(ptn_order[ninf]).isInformative())
+        ninf++;
+
+    // number of bit columns if frequencies are split into weight classes of powers of two
+    int class_size[MAX_CLASS];
+    memset(class_size, 0, sizeof(class_size));
+    for (ptn = 0; ptn < ninf; ptn++)
+        for (k = 0; k < MAX_CLASS; k++)
+            if ((at(ptn_order[ptn]).frequency >> k) & 1)
+                class_size[k]++;
+    size_t weighted_sites = 0;
+    for (k = 0; k < MAX_CLASS; k++)
+        weighted_sites += ((class_size[k] + PARS_BLOCK_BITS - 1) / PARS_BLOCK_BITS) * PARS_BLOCK_BITS;
+    bool weighted = weighted_sites < ((num_informative_sites + PARS_BLOCK_BITS - 1) / PARS_BLOCK_BITS) * PARS_BLOCK_BITS;
+
+    // constant pattern to fill up a weight class, it never costs a substitution
+    Pattern dummy;
+    if (ninf > 0)
+        dummy = at(ptn_order[0]);
+    dummy.assign(getNSeq(), 0);
+    dummy.num_chars = 1;
+
     ordered_pattern.clear();
-    for (ptn = 0, site = 0, i = 0; ptn < nptn; ptn++) {
-        if (!at(ptn_order[ptn]).isInformative())
+    pars_site_weight.clear();
+    num_parsimony_sites = 0;
+    for (k = 0; k < MAX_CLASS; k++) {
+        if (!weighted && k > 0)
             break;
-        ordered_pattern.push_back(at(ptn_order[ptn]));
-        int freq = ordered_pattern.back().frequency;
-        UINT num = ordered_pattern.back().num_chars - 1;
+        site = 0;
+        for (ptn = 0; ptn < ninf; ptn++) {
+            Pattern &pat = at(ptn_order[ptn]);
+            if (!weighted) {
+                ordered_pattern.push_back(pat);
+                site += pat.frequency;
+            } else if ((pat.frequency >> k) & 1) {
+                ordered_pattern.push_back(pat);
+                ordered_pattern.back().frequency = 1;
+                site++;
+            }
+        }
+        if (site % PARS_BLOCK_BITS != 0) {
+            dummy.frequency = PARS_BLOCK_BITS - site % PARS_BLOCK_BITS;
+            ordered_pattern.push_back(dummy);
+            site += dummy.frequency;
+        }
+        pars_site_weight.insert(pars_site_weight.end(), site/UINT_BITS, (UINT)1 << k);
+        num_parsimony_sites += site;
+    }
+
+    int maxi = num_parsimony_sites/UINT_BITS;
+    if (pars_lower_bound)
+        delete [] pars_lower_bound;
+    pars_lower_bound = new UINT[maxi+1];
+    UINT sum = 0;
+    memset(pars_lower_bound, 0, (maxi+1)*sizeof(UINT));
+    site = 0;
+    for (vector<Pattern>::iterator pit = ordered_pattern.begin(); pit != ordered_pattern.end(); pit++) {
+        int freq = pit->frequency;
+        UINT num = pit->num_chars - 1;
         for (int j = 0; j < freq; j++, site++) {
             if (site == UINT_BITS) {
                 sum += pars_lower_bound[i];
                 i++;
                 site = 0;
             }
-            pars_lower_bound[i] += num;
+            pars_lower_bound[i] += num * pars_site_weight[i];
         }
     }
     sum += pars_lower_bound[i];
@@ -819,6 +871,8 @@ void Alignment::orderPatternByNumChars() {
             cout << pars_lower_bound[j] << " ";
         }
         cout << endl << sum << endl;
+        cout << num_parsimony_sites << " parsimony sites for " << num_informative_sites << " informative sites"
+             << (weighted ? " (weighted patterns)" : "") << endl;
     }
     delete [] ptn_order;
     delete [] num_chars;
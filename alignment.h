@@ -25,6 +25,13 @@ const int NUM_CHAR = 256;
 const double MIN_FREQUENCY          = 0.0001;
 const double MIN_FREQUENCY_DIFF     = 0.00001;
 
+/** parsimony bit-vectors of every weight class are padded to a multiple of the widest SIMD vector */
+#ifdef INCLUDE_AVX512
+const int PARS_BLOCK_BITS = 512;
+#else
+const int PARS_BLOCK_BITS = 256;
+#endif
+
 typedef bitset<NUM_CHAR> StateBitset;
 
 enum SeqType {
@@ -156,12 +163,26 @@ public:
      */
     void extractDataBlock(NxsCharactersBlock *data_block);
 
+    /**
+        informative patterns in the bit-vector layout used by the fast parsimony kernels,
+        here frequency is the number of bit columns the pattern occupies.
+        Patterns are grouped into weight classes, each padded with constant patterns
+        to a multiple of PARS_BLOCK_BITS columns.
+    */
     vector<Pattern> ordered_pattern;
+
+    /** total number of bit columns of ordered_pattern */
+    int num_parsimony_sites;
+
+    /** weight of every UINT word of the parsimony bit-vectors */
+    vector<UINT> pars_site_weight;
     
     /** lower bound of sum parsimony scores for remaining pattern in ordered_pattern */
     UINT *pars_lower_bound;
 
-    /** order pattern by number of character states and return in ptn_order
+    /** order pattern by number of character states and return in ptn_order.
+        If it saves bit columns, a pattern of frequency f is not repeated f times but stored once
+        in the weight class 2^k for every bit k set in f.
     */
     virtual void orderPatternByNumChars();
 
@@ -0,0 +1,196 @@
+/*
+ * bootweights.cpp
+ *
+ *  Pattern weights of UFBoot replicates and the blocked RELL kernel
+ */
+
+#include "phylotree.h"
+#include "alignment.h"
+#include "bootweights.h"
+
+BootWeights::BootWeights() {
+	nsamples = 0;
+	nptn = 0;
+	nblocks = 0;
+	storage = BWS_UINT16;
+	counts16 = NULL;
+	counts8 = NULL;
+	aln = NULL;
+	spec = NULL;
+	seed = 0;
+}
+
+BootWeights::~BootWeights() {
+	clear();
+}
+
+void BootWeights::init(size_t nsamples, size_t nptn, BootWeightStorage storage,
+		Alignment *aln, const char *spec, int seed) {
+	clear();
+	this->nsamples = nsamples;
+	this->nptn = nptn;
+	this->storage = storage;
+	this->aln = aln;
+	this->spec = spec;
+	this->seed = seed;
+	nblocks = (nsamples + BOOT_BLOCK_SIZE - 1) / BOOT_BLOCK_SIZE;
+	size_t mem_size = nblocks * nptn * BOOT_BLOCK_SIZE;
+	switch (storage) {
+	case BWS_UINT16:
+		counts16 = aligned_alloc<uint16_t>(mem_size);
+		memset(counts16, 0, mem_size * sizeof(uint16_t));
+		break;
+	case BWS_UINT8:
+		counts8 = aligned_alloc<uint8_t>(mem_size);
+		memset(counts8, 0, mem_size * sizeof(uint8_t));
+		break;
+	case BWS_SEED:
+		ASSERT(aln);
+		break;
+	}
+}
+
+void BootWeights::clear() {
+	if (counts16)
+		aligned_free(counts16);
+	if (counts8)
+		aligned_free(counts8);
+	counts16 = NULL;
+	counts8 = NULL;
+	overflows.clear();
+	nsamples = nptn = nblocks = 0;
+}
+
+/** store counts of one replicate into a strided matrix column, saturating at the type maximum */
+template <class T>
+static void storeSample(T *column, IntVector &counts, int sample, vector<BootWeightOverflow> &overflows) {
+	const int max_count = (T)(~(T)0);
+	for (size_t ptn = 0; ptn < counts.size(); ptn++) {
+		if (counts[ptn] > max_count) {
+			BootWeightOverflow overflow = {sample, (int)ptn, counts[ptn] - max_count};
+			overflows.push_back(overflow);
+			column[ptn*BOOT_BLOCK_SIZE] = max_count;
+		} else
+			column[ptn*BOOT_BLOCK_SIZE] = counts[ptn];
+	}
+}
+
+void BootWeights::setSample(size_t sample, IntVector &counts) {
+	ASSERT(sample < nsamples && counts.size() <= nptn && isStored());
+	size_t offset = (sample / BOOT_BLOCK_SIZE) * nptn * BOOT_BLOCK_SIZE + (sample % BOOT_BLOCK_SIZE);
+	if (counts16)
+		storeSample(counts16 + offset, counts, sample, overflows);
+	else
+		storeSample(counts8 + offset, counts, sample, overflows);
+}
+
+void BootWeights::generateSample(size_t sample, int *counts) {
+	int *rstream;
+	init_random(seed + sample, false, &rstream);
+	aln->createBootstrapAlignment(counts, spec, rstream);
+	finish_random(rstream);
+}
+
+void BootWeights::getSample(size_t sample, IntVector &counts) {
+	counts.resize(nptn);
+	if (storage == BWS_SEED) {
+		generateSample(sample, &counts[0]);
+		return;
+	}
+	size_t offset = (sample / BOOT_BLOCK_SIZE) * nptn * BOOT_BLOCK_SIZE + (sample % BOOT_BLOCK_SIZE);
+	for (size_t ptn = 0; ptn < nptn; ptn++)
+		counts[ptn] = counts16 ? counts16[offset + ptn*BOOT_BLOCK_SIZE] : counts8[offset + ptn*BOOT_BLOCK_SIZE];
+	for (vector<BootWeightOverflow>::iterator it = overflows.begin(); it != overflows.end(); it++)
+		if (it->sample == (int)sample)
+			counts[it->ptn] += it->count;
+}
+
+/**
+ * RELL scores of one block of replicates: the weight matrix of the block is streamed once
+ * and every pattern log-likelihood is broadcast to all BOOT_BLOCK_SIZE accumulators
+ */
+template <class T>
+static void computeBlockRELL(T *counts, double *pattern_lh, size_t nptn, double *acc) {
+	for (size_t i = 0; i < BOOT_BLOCK_SIZE; i++)
+		acc[i] = 0.0;
+	for (size_t ptn = 0; ptn < nptn; ptn++) {
+		double lh = pattern_lh[ptn];
+		T *w = counts + ptn*BOOT_BLOCK_SIZE;
+		for (size_t i = 0; i < BOOT_BLOCK_SIZE; i++)
+			acc[i] += lh * w[i];
+	}
+}
+
+void BootWeights::computeRELL(double *pattern_lh, double *rell, size_t sample_start, size_t sample_end) {
+	if (sample_start >= sample_end)
+		return;
+
+	if (storage == BWS_SEED) {
+		// regenerate every replicate, only one pattern vector per thread lives in memory
+		#ifdef _OPENMP
+		#pragma omp parallel
+		#endif
+		{
+			int *counts = new int[nptn];
+			#ifdef _OPENMP
+			#pragma omp for schedule(dynamic)
+			#endif
+			for (int sample = (int)sample_start; sample < (int)sample_end; sample++) {
+				generateSample(sample, counts);
+				double res = 0.0;
+				for (size_t ptn = 0; ptn < nptn; ptn++)
+					res += pattern_lh[ptn] * counts[ptn];
+				rell[sample] = res;
+			}
+			delete [] counts;
+		}
+		return;
+	}
+
+	int first_block = sample_start / BOOT_BLOCK_SIZE;
+	int last_block = (sample_end + BOOT_BLOCK_SIZE - 1) / BOOT_BLOCK_SIZE;
+	size_t block_size = nptn * BOOT_BLOCK_SIZE;
+
+	#ifdef _OPENMP
+	#pragma omp parallel for schedule(dynamic) if(last_block - first_block > 1)
+	#endif
+	for (int block = first_block; block < last_block; block++) {
+		double acc[BOOT_BLOCK_SIZE];
+		if (counts16)
+			computeBlockRELL(counts16 + block*block_size, pattern_lh, nptn, acc);
+		else
+			computeBlockRELL(counts8 + block*block_size, pattern_lh, nptn, acc);
+		size_t start = max(sample_start, (size_t)block*BOOT_BLOCK_SIZE);
+		size_t end = min(sample_end, (size_t)(block+1)*BOOT_BLOCK_SIZE);
+		for (size_t sample = start; sample < end; sample++)
+			rell[sample] = acc[sample - (size_t)block*BOOT_BLOCK_SIZE];
+	}
+
+	// add the counts that did not fit into the matrix
+	for (vector<BootWeightOverflow>::iterator it = overflows.begin(); it != overflows.end(); it++)
+		if (it->sample >= (int)sample_start && it->sample < (int)sample_end)
+			rell[it->sample] += pattern_lh[it->ptn] * it->count;
+}
+
+int64_t BootWeights::getMemoryRequired(size_t nsamples, size_t nptn, BootWeightStorage storage) {
+	size_t nblocks = (nsamples + BOOT_BLOCK_SIZE - 1) / BOOT_BLOCK_SIZE;
+	switch (storage) {
+	case BWS_UINT16:
+		return (int64_t)nblocks * nptn * BOOT_BLOCK_SIZE * sizeof(uint16_t);
+	case BWS_UINT8:
+		return (int64_t)nblocks * nptn * BOOT_BLOCK_SIZE * sizeof(uint8_t);
+	case BWS_SEED:
+		// one pattern vector per thread
+		return (int64_t)nptn * sizeof(int) * countPhysicalCPUCores();
+	}
+	return 0;
+}
+
+const char *BootWeights::getStorageName(BootWeightStorage storage) {
+	switch (storage) {
+	case BWS_UINT16: return "16-bit counts";
+	case BWS_UINT8: return "8-bit counts";
+	case BWS_SEED: return "regenerated from seeds";
+	}
+	return "";
+}
@@ -0,0 +1,146 @@
+/***************************************************************************
+ *   Copyright (C) 2009-2015 by                                            *
+ *   BUI Quang Minh <minh.bui@univie.ac.at>                                *
+ *   Lam-Tung Nguyen <nltung@gmail.com>                                    *
+ *                                                                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifndef BOOTWEIGHTS_H_
+#define BOOTWEIGHTS_H_
+
+#include "tools.h"
+
+/** number of replicates stored side by side for each pattern */
+#define BOOT_BLOCK_SIZE 64
+
+class Alignment;
+
+/** part of a replicate weight that does not fit into the matrix entry type */
+struct BootWeightOverflow {
+	int sample;
+	int ptn;
+	int count;
+};
+
+/**
+ * Pattern weights of all UFBoot replicates.
+ * Weights are kept in one contiguous matrix, cut into blocks of BOOT_BLOCK_SIZE
+ * replicates; inside a block the layout is pattern-major, i.e. the weights of
+ * all replicates of the block for one pattern are adjacent. The RELL scores of
+ * a whole block are then obtained by one pass over the pattern log-likelihoods.
+ * Counts are stored as 16-bit or 8-bit integers; the rare counts beyond that range
+ * are saturated in the matrix and their remainder kept in an overflow list.
+ * With BWS_SEED no matrix is stored at all and every replicate is regenerated
+ * from its own random stream whenever its RELL score is needed.
+ */
+class BootWeights {
+public:
+
+	BootWeights();
+
+	~BootWeights();
+
+	/**
+	 * allocate zero weights
+	 * @param nsamples number of bootstrap replicates
+	 * @param nptn number of patterns
+	 * @param storage encoding of the weights
+	 * @param aln alignment to regenerate replicates from (BWS_SEED)
+	 * @param spec bootstrap specification (BWS_SEED)
+	 * @param seed random seed of replicate 0 (BWS_SEED)
+	 */
+	void init(size_t nsamples, size_t nptn, BootWeightStorage storage = BWS_UINT16,
+			Alignment *aln = NULL, const char *spec = NULL, int seed = 0);
+
+	/** release memory */
+	void clear();
+
+	/** @return number of replicates */
+	size_t size() { return nsamples; }
+
+	/** @return TRUE if no replicates were allocated */
+	bool empty() { return nsamples == 0; }
+
+	/** @return TRUE if setSample() must be called to fill the weights */
+	bool isStored() { return storage != BWS_SEED; }
+
+	/**
+	 * set the pattern weights of one replicate, only for stored weights
+	 * @param sample replicate ID
+	 * @param counts number of times each pattern was drawn
+	 */
+	void setSample(size_t sample, IntVector &counts);
+
+	/**
+	 * get the pattern weights of one replicate
+	 * @param sample replicate ID
+	 * @param[out] counts number of times each pattern was drawn
+	 */
+	void getSample(size_t sample, IntVector &counts);
+
+	/**
+	 * compute the RELL log-likelihoods of replicates [sample_start, sample_end)
+	 * @param pattern_lh pattern log-likelihoods of the current tree
+	 * @param[out] rell RELL log-likelihoods, indexed by replicate ID
+	 */
+	void computeRELL(double *pattern_lh, double *rell, size_t sample_start, size_t sample_end);
+
+	/** @return number of bytes needed to store the weights */
+	static int64_t getMemoryRequired(size_t nsamples, size_t nptn, BootWeightStorage storage);
+
+	/** @return name of the storage mode */
+	static const char *getStorageName(BootWeightStorage storage);
+
+protected:
+
+	/** regenerate the weights of one replicate from its random stream (BWS_SEED) */
+	void generateSample(size_t sample, int *counts);
+
+	/** number of replicates */
+	size_t nsamples;
+
+	/** number of patterns */
+	size_t nptn;
+
+	/** number of blocks of BOOT_BLOCK_SIZE replicates */
+	size_t nblocks;
+
+	/** encoding of the weights */
+	BootWeightStorage storage;
+
+	/** 16-bit weights for BWS_UINT16 */
+	uint16_t *counts16;
+
+	/** 8-bit weights for BWS_UINT8 */
+	uint8_t *counts8;
+
+	/** counts beyond the range of the matrix entries */
+	vector<BootWeightOverflow> overflows;
+
+	/** alignment for BWS_SEED */
+	Alignment *aln;
+
+	/** bootstrap specification for BWS_SEED */
+	const char *spec;
+
+	/** seed of replicate 0 for BWS_SEED */
+	int seed;
+
+};
+
+#endif /* BOOTWEIGHTS_H_ */
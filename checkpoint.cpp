@@ -20,6 +20,7 @@ Checkpoint::Checkpoint() {
     struct_name = "";
     compression = true;
     header = CKP_HEADER;
+    record_time_budget = false;
 }
 
 
@@ -119,6 +120,10 @@ void Checkpoint::setDumpInterval(double interval) {
     dump_interval = interval;
 }
 
+void Checkpoint::setRecordTimeBudget(bool record) {
+    record_time_budget = record;
+}
+
 void Checkpoint::dump(ostream &out) {
     string struct_name;
     size_t pos;
@@ -145,6 +150,13 @@ void Checkpoint::dump(bool force) {
         return;
     }
     prev_dump_time = getRealTime();
+    if (record_time_budget && Params::getInstance().time_budget > 0) {
+        // stored at the top level, whatever struct is currently open
+        stringstream ss;
+        ss.precision(10);
+        ss << prev_dump_time - Params::getInstance().time_budget_start;
+        (*this)["timeBudgetUsed"] = ss.str();
+    }
     try {
         ostream *out;
         if (compression) 
@@ -105,6 +105,13 @@ public:
     */
     void setDumpInterval(double interval);
 
+    /**
+        record the wall-clock time used of the -deadline budget (key "timeBudgetUsed") with every dump,
+        so that a resumed run only gets the rest of the budget
+        @param record true to record
+    */
+    void setRecordTimeBudget(bool record);
+
 	/**
 	 * @return true if checkpoint contains the key
 	 * @param key key to search for
@@ -360,6 +367,9 @@ protected:
     
     /** header line of checkpoint file */
     string header;
+
+    /** true to record the time used of the -deadline budget, false (default) otherwise */
+    bool record_time_budget;
     
 private:
 
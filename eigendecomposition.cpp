@@ -17,6 +17,10 @@
  *   Free Software Foundation, Inc.,                                       *
  *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
  ***************************************************************************/
+#ifdef USE_EIGEN3
+// before tools.h, whose matrix() macro clashes with Eigen
+#include <Eigen/Eigenvalues>
+#endif
 #include "eigendecomposition.h"
 #include "optimization.h"
 #include <math.h>
@@ -212,10 +216,27 @@ void EigenDecomposition::eigensystem_sym(double **rate_params, double *state_fre
 
 	symmetrizeRateMatrix(a, new_forg, forg_sqrt, new_num); 
 
+#ifdef USE_EIGEN3
+	// eigenvalues and eigenvectors by the blocked solver of Eigen on contiguous memory,
+	// eigenvectors are the columns as with tqli()
+	Eigen::MatrixXd sym_mat(new_num, new_num);
+	for (i = 0; i < new_num; i++)
+		for (j = 0; j < new_num; j++)
+			sym_mat(i, j) = a[i][j];
+	Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> eigen_solver(sym_mat);
+	if (eigen_solver.info() != Eigen::Success)
+		outError("Eigen decomposition of the rate matrix did not converge");
+	for (i = 0; i < new_num; i++) {
+		eval_new[i] = eigen_solver.eigenvalues()(i);
+		for (j = 0; j < new_num; j++)
+			a[i][j] = eigen_solver.eigenvectors()(i, j);
+	}
+#else
 	// make this matrix tridiagonal
 	tred2(a, new_num, eval_new, off_diag);
 	// compute eigenvalues and eigenvectors
 	tqli(eval_new, off_diag, new_num, a);
+#endif
 
 	// now get back eigen
 	//for (i = 0,inew = 0; i < num_state; i++)
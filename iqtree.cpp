@@ -63,6 +63,11 @@ void IQTree::init() {
     len_scale = 10000;
 //    save_all_br_lens = false;
     duplication_counter = 0;
+    num_known_topo_hits = 0;
+    fast_search_full_ncat = 0;
+    fast_search_stable_splits = 0;
+    fast_search_stable_iter = 0;
+    budget_endgame = false;
     //boot_splits = new SplitGraph;
     pll2iqtree_pattern_index = NULL;
 
@@ -105,7 +110,7 @@ void IQTree::saveUFBoot(Checkpoint *checkpoint) {
             checkpoint->addListElement();
             stringstream ss;
             ss.precision(10);
-            ss << boot_counts[id] << " " << boot_logl[id] << " " << boot_orig_logl[id] << " " << boot_trees[id];
+            ss << boot_counts[id] << " " << boot_logl[id] << " " << boot_orig_logl[id] << " " << getBootTree(id);
             checkpoint->put("", ss.str());
         }
         checkpoint->endList();
@@ -120,7 +125,7 @@ void IQTree::saveUFBoot(Checkpoint *checkpoint) {
             checkpoint->addListElement();
             stringstream ss;
             ss.precision(10);
-            ss << boot_counts[id] << " " << boot_logl[id] << " " << boot_orig_logl[id] << " " << boot_trees[id];
+            ss << boot_counts[id] << " " << boot_logl[id] << " " << boot_orig_logl[id] << " " << getBootTree(id);
             checkpoint->put("", ss.str());
         }
         checkpoint->endList();
@@ -132,7 +137,7 @@ void IQTree::saveCheckpoint() {
     stop_rule.saveCheckpoint();
     candidateTrees.saveCheckpoint();
     
-    if (boot_samples.size() > 0 && !boot_trees.front().empty()) {
+    if (boot_samples.size() > 0 && boot_tree_ids.front() >= 0) {
         saveUFBoot(checkpoint);
         // boot_splits
         int id = 0;
@@ -142,6 +147,14 @@ void IQTree::saveCheckpoint() {
             checkpoint->endStruct();
         }
     }
+
+    if (params->fast_search_ncat > 0) {
+        checkpoint->startStruct("FastSearch");
+        CKP_SAVE(fast_search_full_ncat);
+        CKP_SAVE(fast_search_stable_splits);
+        CKP_SAVE(fast_search_stable_iter);
+        checkpoint->endStruct();
+    }
     
     PhyloTree::saveCheckpoint();
 }
@@ -157,11 +170,13 @@ void IQTree::restoreUFBoot(Checkpoint *checkpoint) {
     checkpoint->setListElement(sample_start-1);
     for (id = sample_start; id != sample_end; id++) {
         checkpoint->addListElement();
-        string str;
+        string str, tree_str;
         checkpoint->getString("", str);
         assert(!str.empty());
         stringstream ss(str);
-        ss >> boot_counts[id] >> boot_logl[id] >> boot_orig_logl[id] >> boot_trees[id];
+        ss >> boot_counts[id] >> boot_logl[id] >> boot_orig_logl[id] >> tree_str;
+        if (!tree_str.empty())
+            setBootTree(id, getBootTopologyID(tree_str));
     }
     checkpoint->endList();
     checkpoint->endStruct();
@@ -172,6 +187,14 @@ void IQTree::restoreCheckpoint() {
     stop_rule.restoreCheckpoint();
     candidateTrees.restoreCheckpoint();
 
+    if (params->fast_search_ncat > 0) {
+        checkpoint->startStruct("FastSearch");
+        CKP_RESTORE(fast_search_full_ncat);
+        CKP_RESTORE(fast_search_stable_splits);
+        CKP_RESTORE(fast_search_stable_iter);
+        checkpoint->endStruct();
+    }
+
     if (params->gbo_replicates > 0 && checkpoint->hasKey("UFBoot.logl_cutoff")) {
         checkpoint->startStruct("UFBoot");
 //        CKP_RESTORE(max_candidate_trees);
@@ -179,16 +202,18 @@ void IQTree::restoreCheckpoint() {
         // save boot_samples and boot_trees
         int id = 0;
         checkpoint->startList(params->gbo_replicates);
-        boot_trees.resize(params->gbo_replicates);
+        boot_tree_ids.resize(params->gbo_replicates, -1);
         boot_logl.resize(params->gbo_replicates);
         boot_orig_logl.resize(params->gbo_replicates);
         boot_counts.resize(params->gbo_replicates);
         for (id = 0; id < params->gbo_replicates; id++) {
             checkpoint->addListElement();
-            string str;
+            string str, tree_str;
             checkpoint->getString("", str);
             stringstream ss(str);
-            ss >> boot_counts[id] >> boot_logl[id] >> boot_orig_logl[id] >> boot_trees[id];
+            ss >> boot_counts[id] >> boot_logl[id] >> boot_orig_logl[id] >> tree_str;
+            if (!tree_str.empty())
+                setBootTree(id, getBootTopologyID(tree_str));
         }
         checkpoint->endList();
         CKP_RESTORE(boot_consense_logl);
@@ -329,8 +354,14 @@ void IQTree::initSettings(Params &params) {
         init_random(params.ran_seed);
         
         cout << "Generating " << params.gbo_replicates << " samples for ultrafast bootstrap (seed: " << params.ran_seed << ")..." << endl;
+        if (params.ufboot_weight_storage == BWS_SEED && params.print_bootaln)
+            outError("Bootstrap alignments cannot be printed with -bbw seed");
         // allocate memory for boot_samples
-        boot_samples.resize(params.gbo_replicates);
+        boot_samples.init(params.gbo_replicates, getAlnNPattern(), params.ufboot_weight_storage,
+            aln, params.bootstrap_spec, params.ran_seed);
+        cout << "UFBoot replicate weights: " << BootWeights::getStorageName(params.ufboot_weight_storage) << " ("
+            << BootWeights::getMemoryRequired(params.gbo_replicates, getAlnNPattern(), params.ufboot_weight_storage) / 1048576
+            << " MB)" << endl;
         sample_start = 0;
         sample_end = boot_samples.size();
 
@@ -345,26 +376,16 @@ void IQTree::initSettings(Params &params) {
                 sample_end = boot_samples.size();
         }
 
-        size_t orig_nptn = getAlnNPattern();
-#ifdef BOOT_VAL_FLOAT
-        size_t nptn = get_safe_upper_limit_float(orig_nptn);
-#else
-        size_t nptn = get_safe_upper_limit(orig_nptn);
-#endif
-        BootValType *mem = aligned_alloc<BootValType>(nptn * (size_t)(params.gbo_replicates));
-        memset(mem, 0, nptn * (size_t)(params.gbo_replicates) * sizeof(BootValType));
-        for (i = 0; i < params.gbo_replicates; i++)
-        	boot_samples[i] = mem + i*nptn;
 
-        if (boot_trees.empty()) {
+        if (boot_tree_ids.empty()) {
             boot_logl.resize(params.gbo_replicates, -DBL_MAX);
             boot_orig_logl.resize(params.gbo_replicates, -DBL_MAX);
-            boot_trees.resize(params.gbo_replicates, "");
+            boot_tree_ids.resize(params.gbo_replicates, -1);
             boot_counts.resize(params.gbo_replicates, 0);
             if (params.print_ufboot_trees == 2)
                 boot_trees_brlen.resize(params.gbo_replicates);
         } else {
-            cout << "CHECKPOINT: " << boot_trees.size() << " UFBoot trees and " << boot_splits.size() << " UFBootSplits restored" << endl;
+            cout << "CHECKPOINT: " << boot_tree_ids.size() << " UFBoot trees and " << boot_splits.size() << " UFBootSplits restored" << endl;
             // TODO: quick and dirty fix, no branch lengths are saved after checkpointing
             if (params.print_ufboot_trees == 2) {
                 boot_trees_brlen.resize(params.gbo_replicates);
@@ -381,7 +402,8 @@ void IQTree::initSettings(Params &params) {
         }
         VerboseMode saved_mode = verbose_mode;
         verbose_mode = VB_QUIET;
-        for (i = 0; i < params.gbo_replicates; i++) {
+        // with -bbw seed replicates are regenerated on demand
+        for (i = 0; i < params.gbo_replicates && boot_samples.isStored(); i++) {
         	if (params.print_bootaln) {
     			Alignment* bootstrap_alignment;
     			if (aln->isSuperAlignment())
@@ -390,15 +412,13 @@ void IQTree::initSettings(Params &params) {
     				bootstrap_alignment = new Alignment;
     			IntVector this_sample;
     			bootstrap_alignment->createBootstrapAlignment(aln, &this_sample, params.bootstrap_spec);
-    			for (size_t j = 0; j < orig_nptn; j++)
-    				boot_samples[i][j] = this_sample[j];
+    			boot_samples.setSample(i, this_sample);
 				bootstrap_alignment->printPhylip(bootaln_name.c_str(), true);
 				delete bootstrap_alignment;
         	} else {
     			IntVector this_sample;
         		aln->createBootstrapAlignment(this_sample, params.bootstrap_spec);
-    			for (size_t j = 0; j < orig_nptn; j++)
-    				boot_samples[i][j] = this_sample[j];
+    			boot_samples.setSample(i, this_sample);
         	}
         }
         verbose_mode = saved_mode;
@@ -432,10 +452,12 @@ IQTree::~IQTree() {
     boot_splits.clear();
     //if (boot_splits) delete boot_splits;
 
-    if (!boot_samples.empty()) {
-    	aligned_free(boot_samples[0]); // free memory
-        boot_samples.clear();
-    }
+    for (vector<Split*>::reverse_iterator it = boot_split_list.rbegin(); it != boot_split_list.rend(); it++)
+        if (*it)
+            delete (*it);
+    boot_split_list.clear();
+
+    boot_samples.clear();
 }
 
 extern const char *aa_model_names_rax[];
@@ -749,6 +771,11 @@ void IQTree::initCandidateTreeSet(int nParTrees, int nNNITrees) {
     for (vector<string>::iterator it = initTreeStrings.begin(); it != initTreeStrings.end(); ++it) {
         string treeString;
         double score;
+        if (!candidateTrees.empty() && getRemainingTimeBudget(BUDGET_INITIAL_TREES) <= 0) {
+            cout << "NOTE: Time budget for initial trees used up, " << initTreeStrings.end() - it
+                 << " trees not evaluated" << endl;
+            break;
+        }
         readTreeString(*it);
         if (it-initTreeStrings.begin() >= init_size)
             treeString = optimizeBranches(2);
@@ -804,6 +831,11 @@ void IQTree::initCandidateTreeSet(int nParTrees, int nNNITrees) {
     candidateTrees.setMaxSize(Params::getInstance().numSupportTrees);
 
     for (vector<string>::iterator it = bestInitTrees.begin(); it != bestInitTrees.end(); it++) {
+        if (it != bestInitTrees.begin() && getRemainingTimeBudget(BUDGET_INITIAL_TREES) <= 0) {
+            cout << "NOTE: Time budget for initial trees used up after " << it - bestInitTrees.begin()
+                 << " NNI searches" << endl;
+            break;
+        }
         readTreeString(*it);
         doNNISearch();
         string treeString = getTreeString();
@@ -2109,7 +2141,7 @@ string IQTree::optimizeBranches(int maxTraversal) {
 
 void IQTree::collectBootTrees() {
 #ifdef _IQTREE_MPI
-	if (boot_trees.size() == 0)
+	if (boot_tree_ids.size() == 0)
 			return;
     // send UFBoot trees between processes
     if (MPIHelper::getInstance().isMaster()) {
@@ -2120,11 +2152,11 @@ void IQTree::collectBootTrees() {
             int source = MPIHelper::getInstance().receiveTrees(trees, BOOT_TREE_TAG);
             if (source > 0) {
                 count++;
-                assert(trees.getNumTrees() == boot_trees.size());
+                assert(trees.getNumTrees() == boot_tree_ids.size());
                 int better_trees = 0;
                 for (int id = 0; id < trees.getNumTrees(); id++)
                     if (trees.getScores()[id] > boot_logl[id]) {
-                        boot_trees[id] = trees.getTreeStrings()[id];
+                        setBootTree(id, getBootTopologyID(trees.getTreeStrings()[id]));
                         boot_logl[id] = trees.getScores()[id];
                         better_trees++; 
                     }
@@ -2134,8 +2166,12 @@ void IQTree::collectBootTrees() {
         } while (count < MPIHelper::getInstance().getNumProcesses()-1);
     } else {
         // worker
-        if (MPIHelper::getInstance().checkMsg(BOOT_TAG))
+        if (MPIHelper::getInstance().checkMsg(BOOT_TAG)) {
+            StrVector boot_trees;
+            for (int id = 0; id < boot_tree_ids.size(); id++)
+                boot_trees.push_back(getBootTree(id));
             MPIHelper::getInstance().sendTrees(PROC_MASTER, boot_trees, boot_logl, BOOT_TREE_TAG);
+        }
         string msg;
         if (MPIHelper::getInstance().checkMsg(LOGL_CUTOFF_TAG, msg)) {
             logl_cutoff = convert_double(msg.c_str());
@@ -2166,6 +2202,21 @@ double IQTree::doTreeSearch() {
     if (treesPerProc < 1 && params->numInitTrees > candidateTrees.size())
         treesPerProc = 1;
 
+    // early iterations with fewer rate categories
+    if (params->fast_search_ncat > 0 && !getCheckpoint()->getBool("finishedFastSearch")) {
+        if (isSuperTree() || params->pll || !site_rate->isGammaRate() || params->gbo_replicates > 0)
+            outWarning("-fastcat is only supported for single +G models without ultrafast bootstrap, ignored");
+        else if (fast_search_full_ncat > 0) {
+            // resumed during the fast search phase: the checkpointed model and candidate trees
+            // are those of the fast search
+            site_rate->setNCategory(params->fast_search_ncat);
+            deleteAllPartialLh();
+            initializeAllPartialLh();
+            cout << "CHECKPOINT: Fast search with " << params->fast_search_ncat << " rate categories resumed" << endl;
+        } else if (site_rate->getNDiscreteRate() > params->fast_search_ncat)
+            switchFastSearchModel(true);
+    }
+
     /* Initialize candidate tree set */
     if (!getCheckpoint()->getBool("finishedCandidateSet")) {
         initCandidateTreeSet(treesPerProc, params->numNNITrees);
@@ -2220,6 +2271,10 @@ double IQTree::doTreeSearch() {
     // tracking of worker candidate set is changed from master candidate set
     candidateset_changed.resize(MPIHelper::getInstance().getNumProcesses(), false);
     bestcandidate_changed = false;
+    budget_endgame = false;
+    // the endgame reduces these for the rest of this search only
+    int saved_pop_size = Params::getInstance().popSize;
+    double saved_init_ps = Params::getInstance().initPS;
 
     /*==============================================================================================================
 	                                       MAIN LOOP OF THE IQ-TREE ALGORITHM
@@ -2258,6 +2313,16 @@ double IQTree::doTreeSearch() {
 #endif
 */
         searchinfo.curIter = stop_rule.getCurIt();
+
+        // few iterations left before the deadline: perturb the best trees only and less strongly
+        if (!budget_endgame && stop_rule.getBudgetIterations() < BUDGET_ENDGAME_ITERATIONS) {
+            budget_endgame = true;
+            Params::getInstance().popSize = max(1, Params::getInstance().popSize / 2);
+            Params::getInstance().initPS /= 2;
+            cout << "NOTE: Close to the time budget, perturbing " << Params::getInstance().popSize
+                 << " best trees with strength " << Params::getInstance().initPS << endl;
+        }
+
         // estimate logl_cutoff for bootstrap
         if (!boot_orig_logl.empty())
             logl_cutoff = *min_element(boot_orig_logl.begin(), boot_orig_logl.end());
@@ -2285,6 +2350,19 @@ double IQTree::doTreeSearch() {
         if (pos != -2 && pos != -1 && (Params::getInstance().fixStableSplits || Params::getInstance().adaptPertubation))
             candidateTrees.computeSplitOccurences(Params::getInstance().stableSplitThreshold);
 
+        // switch to the full model once the stable splits of the candidate set do not grow anymore
+        if (fast_search_full_ncat > 0) {
+            CandidateSet topTrees = candidateTrees.getBestCandidateTrees(params->numSupportTrees);
+            topTrees.setAln(aln);
+            int numStableSplits = topTrees.computeSplitOccurences(params->stableSplitThreshold);
+            if (numStableSplits > fast_search_stable_splits) {
+                fast_search_stable_splits = numStableSplits;
+                fast_search_stable_iter = stop_rule.getCurIt();
+            } else if (stop_rule.getCurIt() - fast_search_stable_iter >= FAST_SEARCH_STABLE_ITERATIONS) {
+                switchFastSearchModel(false);
+            }
+        }
+
         if (MPIHelper::getInstance().isWorker() || MPIHelper::getInstance().gotMessage())
             syncCurrentTree();
 
@@ -2379,6 +2457,24 @@ double IQTree::doTreeSearch() {
             if (params->gbo_replicates && params->online_bootstrap && params->print_ufboot_trees)
                 writeUFBootTrees(*params);
 
+            // keep a UFBoot summary on disk in case the job is killed at its deadline
+            if (params->time_budget > 0) {
+                SplitGraph interim_sg;
+                summarizeBootstrap(interim_sg);
+                interim_sg.scaleWeight(100.0 / boot_tree_ids.size(), true);
+                // write to a temporary file first, so that a job killed while writing
+                // does not leave a truncated file under the final name
+                string splits_file = (string)params->out_prefix + ".splits.nex";
+                string tmp_file = splits_file + ".tmp";
+                interim_sg.saveFile(tmp_file.c_str(), IN_NEXUS, false);
+#if defined WIN32 || defined _WIN32 || defined __WIN32__
+                // rename does not replace an existing file on Windows
+                remove(splits_file.c_str());
+#endif
+                if (rename(tmp_file.c_str(), splits_file.c_str()) != 0)
+                    outError(ERR_WRITE_OUTPUT, splits_file);
+            }
+
         } // end of bootstrap convergence test
 
         // print UFBoot trees every 10 iterations
@@ -2396,9 +2492,20 @@ double IQTree::doTreeSearch() {
 
     }
 
+    if (budget_endgame) {
+        Params::getInstance().popSize = saved_pop_size;
+        Params::getInstance().initPS = saved_init_ps;
+    }
+
+    if (fast_search_full_ncat > 0)
+        switchFastSearchModel(false);
+
     if (optimization_looped)
         sendStopMessage();
 
+    if (num_known_topo_hits > 0 && verbose_mode >= VB_MED)
+        cout << num_known_topo_hits << " NNI searches stopped at already visited topologies" << endl;
+
     readTreeString(candidateTrees.getBestTreeStrings()[0]);
 
     if (testNNI)
@@ -2431,6 +2538,63 @@ double IQTree::doTreeSearch() {
 
 }
 
+void IQTree::switchFastSearchModel(bool fast) {
+    int ncat;
+    if (fast) {
+        fast_search_full_ncat = site_rate->getNDiscreteRate();
+        fast_search_stable_splits = 0;
+        fast_search_stable_iter = stop_rule.getCurIt();
+        ncat = params->fast_search_ncat;
+        cout << "Fast search: using " << ncat << " instead of " << fast_search_full_ncat
+             << " rate categories until the topology stabilises" << endl;
+    } else {
+        ncat = fast_search_full_ncat;
+        fast_search_full_ncat = 0;
+        cout << "Fast search: switching back to " << ncat << " rate categories at iteration "
+             << stop_rule.getCurIt() << endl;
+    }
+    site_rate->setNCategory(ncat);
+    deleteAllPartialLh();
+    initializeAllPartialLh();
+    nni_optimal_topos.clear();
+    nni_optimal_list.clear();
+
+    vector<string> trees = candidateTrees.getBestTreeStrings();
+    // the final model optimization of the search re-fits the model on the best tree
+    bool out_of_time = !fast && stop_rule.isOutOfTime();
+    if (out_of_time) {
+        cout << "Fast search: no time left, only the best tree is kept" << endl;
+        trees.resize(min(trees.size(), (size_t)1));
+    } else {
+        // fit the model for the new number of categories before any tree is scored with it
+        if (!trees.empty())
+            readTreeString(trees[0]);
+        optimizeModelParameters(false, params->modelEps);
+        getModelFactory()->saveCheckpoint();
+    }
+
+    // re-score the candidate trees under the new model
+    candidateTrees.clear();
+    for (vector<string>::iterator it = trees.begin(); it != trees.end(); it++) {
+        readTreeString(*it);
+        double score = optimizeAllBranches(1);
+        candidateTrees.update(getTreeString(), score);
+    }
+
+    if (fast)
+        return;
+    getCheckpoint()->putBool("finishedFastSearch", true);
+    if (out_of_time || trees.empty())
+        return;
+
+    // final polish of the best tree under the full model
+    readTreeString(candidateTrees.getBestTreeStrings()[0]);
+    doNNISearch();
+    addTreeToCandidateSet(getTreeString(), curScore, false, MPIHelper::getInstance().getProcessID());
+    cout << "Best score under the full model: " << candidateTrees.getBestScore() << endl;
+    bestcandidate_changed = true;
+}
+
 void IQTree::printIterationInfo(int sourceProcID) {
     double realtime_remaining = stop_rule.getRemainingTime(stop_rule.getCurIt());
     cout.setf(ios_base::fixed, ios_base::floatfield);
@@ -2600,12 +2764,53 @@ pair<int, int> IQTree::doNNISearch() {
         // Re-optimize model parameters (the sNNI algorithm)
         optimizeModelParameters(false, params->modelEps * 10);
         getModelFactory()->saveCheckpoint();
+        // NNI-optimal topologies found under the old model parameters may no longer be optimal
+        if (params->nni_topo_hash) {
+            nni_optimal_topos.clear();
+            nni_optimal_list.clear();
+            addNNIOptimalTopo(curScore);
+        }
     }
     MPIHelper::getInstance().setNumNNISearch(MPIHelper::getInstance().getNumNNISearch() + 1);
 
     return nniInfos;
 }
 
+void IQTree::addNNIOptimalTopo(double score) {
+    uint64_t hash = getTopologyHash();
+    unordered_map<uint64_t, list<NNIOptimalTopo>::iterator>::iterator it = nni_optimal_topos.find(hash);
+    if (it != nni_optimal_topos.end()) {
+        // same topology with a better score, or a hash collision: keep the newer tree
+        nni_optimal_list.erase(it->second);
+        nni_optimal_topos.erase(it);
+    }
+    NNIOptimalTopo topo;
+    topo.hash = hash;
+    topo.score = score;
+    topo.topology = getTopologyString(false);
+    topo.tree = getTreeString();
+    nni_optimal_list.push_front(topo);
+    nni_optimal_topos[hash] = nni_optimal_list.begin();
+    while (nni_optimal_list.size() > max(params->maxCandidates, 1)) {
+        nni_optimal_topos.erase(nni_optimal_list.back().hash);
+        nni_optimal_list.pop_back();
+    }
+}
+
+bool IQTree::loadNNIOptimalTopo(double &score) {
+    unordered_map<uint64_t, list<NNIOptimalTopo>::iterator>::iterator it = nni_optimal_topos.find(getTopologyHash());
+    if (it == nni_optimal_topos.end())
+        return false;
+    list<NNIOptimalTopo>::iterator topo = it->second;
+    // the hash only says that the topology is most likely the same
+    if (topo->topology != getTopologyString(false))
+        return false;
+    readTreeString(topo->tree);
+    score = topo->score;
+    nni_optimal_list.splice(nni_optimal_list.begin(), nni_optimal_list, topo);
+    return true;
+}
+
 pair<int, int> IQTree::optimizeNNI(bool speedNNI) {
     unsigned int totalNNIApplied = 0;
     unsigned int numSteps = 0;
@@ -2622,8 +2827,21 @@ pair<int, int> IQTree::optimizeNNI(bool speedNNI) {
         tabuSplits = initTabuSplits;
     }
 
+    // the hash is then kept up-to-date by doNNI()
+    if (params->nni_topo_hash)
+        computeTopologyHash();
+
+    bool known_topo = false;
     for (numSteps = 1; numSteps <= MAXSTEPS; numSteps++) {
 
+        // the search leads to a topology already optimized by an earlier NNI search:
+        // take over its optimized branch lengths and score
+        if (params->nni_topo_hash && loadNNIOptimalTopo(curScore)) {
+            num_known_topo_hits++;
+            known_topo = true;
+            break;
+        }
+
 //        cout << "numSteps = " << numSteps << endl;
         double oldScore = curScore;
         if (save_all_trees == 2) {
@@ -2750,13 +2968,17 @@ pair<int, int> IQTree::optimizeNNI(bool speedNNI) {
         }
     }
 
-    if (totalNNIApplied == 0 && verbose_mode >= VB_MED) {
+    if (totalNNIApplied == 0 && !known_topo && verbose_mode >= VB_MED) {
         cout << "NOTE: Input tree is already NNI-optimal" << endl;
     }
 
     if (numSteps == MAXSTEPS) {
         cout << "WARNING: NNI search needs unusual large number of steps (" << numInnerBranches << ") to converge!" << endl;
     }
+
+    if (params->nni_topo_hash && !known_topo)
+        addNNIOptimalTopo(curScore);
+
     return make_pair(numSteps, totalNNIApplied);
 }
 
@@ -2863,9 +3085,11 @@ void IQTree::pllInitUFBootData(){
                 pllUFBootDataPtr->boot_samples[i] =
                     (int *) malloc(pllAlignment->sequenceLength * sizeof(int));
                 if(!pllUFBootDataPtr->boot_samples[i]) outError("Not enough dynamic memory!");
+                IntVector this_sample;
+                boot_samples.getSample(i, this_sample);
                 for(int j = 0; j < pllAlignment->sequenceLength; j++){
                     pllUFBootDataPtr->boot_samples[i][j] =
-                        boot_samples[i][pll2iqtree_pattern_index[j]];
+                        this_sample[pll2iqtree_pattern_index[j]];
                 }
             }
 
@@ -3189,20 +3413,18 @@ void IQTree::saveCurrentTree(double cur_logl) {
         }
         double rand_double = random_double();
 
-        #ifdef _OPENMP
-        #pragma omp parallel for
-        #endif
-        for (int sample = sample_start; sample < sample_end; sample++) {
-            double rell = 0.0;
-
-            {
-            	// SSE optimized version of the above loop
-				BootValType *boot_sample = boot_samples[sample];
-
-				BootValType res = (this->*dotProduct)(pattern_lh, boot_sample, nptn);
+        // RELL scores of all replicates in one blocked pass over pattern_lh
+        DoubleVector rell_vec(boot_samples.size(), 0.0);
+#ifdef BOOT_VAL_FLOAT
+        boot_samples.computeRELL(pattern_lh_orig, rell_vec.data(), sample_start, sample_end);
+#else
+        boot_samples.computeRELL(pattern_lh, rell_vec.data(), sample_start, sample_end);
+#endif
 
-				rell = res;
-            }
+        // topology ID of the current tree, looked up once the first replicate takes it
+        int tree_id = -1;
+        for (int sample = sample_start; sample < sample_end; sample++) {
+            double rell = rell_vec[sample];
 
             bool better = rell > boot_logl[sample] + params->ufboot_epsilon;
             if (!better && rell > boot_logl[sample] - params->ufboot_epsilon) {
@@ -3216,7 +3438,9 @@ void IQTree::saveCurrentTree(double cur_logl) {
                 }
                 boot_logl[sample] = max(boot_logl[sample], rell);
                 boot_orig_logl[sample] = cur_logl;
-                boot_trees[sample] = tree_str;
+                if (tree_id < 0)
+                    tree_id = getBootTopologyID(tree_str);
+                setBootTree(sample, tree_id);
                 if (params->print_ufboot_trees == 2) {
                 	boot_trees_brlen[sample] = tree_str_brlen;
                 }
@@ -3381,8 +3605,17 @@ void IQTree::writeUFBootTrees(Params &params) {
 	ofstream out(filename.c_str());
 
 	if (params.print_ufboot_trees == 1) {
-		// print trees without branch lengths
-        trees.init(boot_trees, rooted);
+		// print trees without branch lengths, each distinct topology is converted only once
+		StrVector topologies;
+		IntVector topology_ids;
+		for (i = 0; i < boot_topologies.size(); i++)
+			if (boot_topology_counts[i] > 0) {
+				topologies.push_back(boot_topologies[i]);
+				topology_ids.push_back(i);
+			}
+        trees.init(topologies, rooted);
+        StrVector topology_str;
+        topology_str.resize(boot_topologies.size());
 		for (i = 0; i < trees.size(); i++) {
 			NodeVector taxa;
 			// change the taxa name from ID to real name
@@ -3393,13 +3626,14 @@ void IQTree::writeUFBootTrees(Params &params) {
 				// reinsert removed seqs into each tree
 				trees[i]->insertTaxa(removed_seqs, twin_seqs);
 			}
-			// now print to file
-			for (j = 0; j < trees.tree_weights[i]; j++)
-				if (params.print_ufboot_trees == 1)
-					trees[i]->printTree(out, WT_NEWLINE);
-				else
-					trees[i]->printTree(out, WT_NEWLINE + WT_BR_LEN);
+			stringstream ss;
+			trees[i]->printTree(ss, WT_NEWLINE);
+			topology_str[topology_ids[i]] = ss.str();
 		}
+		// now print to file in replicate order
+		for (sample = 0; sample < boot_tree_ids.size(); sample++)
+			if (boot_tree_ids[sample] >= 0)
+				out << topology_str[boot_tree_ids[sample]];
 		cout << "UFBoot trees printed to " << filename << endl;
 	} else {
 		// with branch lengths
@@ -3413,26 +3647,129 @@ void IQTree::writeUFBootTrees(Params &params) {
 void IQTree::summarizeBootstrap(Params &params) {
 	setRootNode(params.root);
     MTreeSet trees;
-    trees.init(boot_trees, rooted);
+    // each distinct topology once, weighted by the number of replicates,
+    // in the order replicates first refer to it
+    StrVector topologies;
+    IntVector weights;
+    vector<bool> added(boot_topologies.size(), false);
+    for (IntVector::iterator it = boot_tree_ids.begin(); it != boot_tree_ids.end(); it++)
+        if (*it >= 0 && !added[*it]) {
+            added[*it] = true;
+            topologies.push_back(boot_topologies[*it]);
+            weights.push_back(boot_topology_counts[*it]);
+        }
+    trees.init(topologies, rooted);
+    trees.tree_weights = weights;
     summarizeBootstrap(params, trees);
 }
 
 void IQTree::summarizeBootstrap(SplitGraph &sg) {
-    MTreeSet trees;
-    //SplitGraph sg;
-    trees.init(boot_trees, rooted);
-    SplitIntMap hash_ss;
     // make the taxa name
     vector<string> taxname;
     taxname.resize(leafNum);
     getTaxaName(taxname);
 
-    /*if (!tree.save_all_trees)
-     trees.convertSplits(taxname, sg, hash_ss, SW_COUNT, -1);
-     else
-     trees.convertSplits(taxname, sg, hash_ss, SW_COUNT, -1, false);
-     */
-    trees.convertSplits(taxname, sg, hash_ss, SW_COUNT, -1, NULL, false); // do not sort taxa
+    // split frequencies are maintained by setBootTree, no trees need to be parsed
+    sg.createBlocks();
+    for (vector<string>::iterator its = taxname.begin(); its != taxname.end(); its++)
+        sg.getTaxa()->AddTaxonLabel(NxsString(its->c_str()));
+    // splits in the order replicates first refer to their topologies
+    vector<bool> added(boot_split_list.size(), false);
+    for (IntVector::iterator it = boot_tree_ids.begin(); it != boot_tree_ids.end(); it++) {
+        if (*it < 0)
+            continue;
+        for (IntVector::iterator sit = boot_topology_splits[*it].begin(); sit != boot_topology_splits[*it].end(); sit++)
+            if (!added[*sit]) {
+                added[*sit] = true;
+                sg.push_back(new Split(*boot_split_list[*sit]));
+            }
+    }
+}
+
+int IQTree::getBootTopologyID(const string &tree_str) {
+    StringIntMap::iterator it = boot_topology_index.find(tree_str);
+    if (it != boot_topology_index.end())
+        return it->second;
+    int tree_id;
+    if (boot_topology_free.empty()) {
+        tree_id = boot_topologies.size();
+        boot_topologies.push_back(tree_str);
+        boot_topology_counts.push_back(0);
+        boot_topology_splits.push_back(IntVector());
+    } else {
+        // reuse the slot of a released topology
+        tree_id = boot_topology_free.back();
+        boot_topology_free.pop_back();
+        boot_topologies[tree_id] = tree_str;
+        boot_topology_counts[tree_id] = 0;
+    }
+    boot_topology_index[tree_str] = tree_id;
+
+    // convert the topology into splits once
+    MTree tree;
+    stringstream ss(tree_str);
+    bool myrooted = rooted;
+    tree.readTree(ss, myrooted);
+    NodeVector taxa;
+    tree.getTaxa(taxa);
+    for (NodeVector::iterator taxit = taxa.begin(); taxit != taxa.end(); taxit++)
+        (*taxit)->id = atoi((*taxit)->name.c_str());
+    SplitGraph sg;
+    tree.convertSplits(sg);
+    IntVector &splits = boot_topology_splits[tree_id];
+    for (SplitGraph::iterator sit = sg.begin(); sit != sg.end(); sit++) {
+        int split_id;
+        if (!boot_split_index.findSplit(*sit, split_id)) {
+            Split *sp = new Split(*(*sit));
+            sp->setWeight(0.0);
+            if (boot_split_free.empty()) {
+                split_id = boot_split_list.size();
+                boot_split_list.push_back(sp);
+            } else {
+                split_id = boot_split_free.back();
+                boot_split_free.pop_back();
+                boot_split_list[split_id] = sp;
+            }
+            boot_split_index.insertSplit(sp, split_id);
+        }
+        splits.push_back(split_id);
+    }
+    return tree_id;
+}
+
+void IQTree::setBootTree(int sample, int tree_id) {
+    int old_id = boot_tree_ids[sample];
+    if (old_id == tree_id)
+        return;
+    boot_tree_ids[sample] = tree_id;
+    IntVector::iterator it;
+    if (tree_id >= 0) {
+        boot_topology_counts[tree_id]++;
+        for (it = boot_topology_splits[tree_id].begin(); it != boot_topology_splits[tree_id].end(); it++)
+            boot_split_list[*it]->setWeight(boot_split_list[*it]->getWeight() + 1.0);
+    }
+    if (old_id >= 0) {
+        boot_topology_counts[old_id]--;
+        bool release = (boot_topology_counts[old_id] == 0);
+        for (it = boot_topology_splits[old_id].begin(); it != boot_topology_splits[old_id].end(); it++) {
+            Split *sp = boot_split_list[*it];
+            sp->setWeight(sp->getWeight() - 1.0);
+            if (release && sp->getWeight() <= 0.0) {
+                // no topology in use contains this split any more
+                boot_split_index.eraseSplit(sp);
+                delete sp;
+                boot_split_list[*it] = NULL;
+                boot_split_free.push_back(*it);
+            }
+        }
+        if (release) {
+            // no replicate refers to this topology any more, release its slot
+            boot_topology_index.erase(boot_topologies[old_id]);
+            string().swap(boot_topologies[old_id]);
+            IntVector().swap(boot_topology_splits[old_id]);
+            boot_topology_free.push_back(old_id);
+        }
+    }
 }
 
 void IQTree::pllConvertUFBootData2IQTree(){
@@ -3444,9 +3781,12 @@ void IQTree::pllConvertUFBootData2IQTree(){
 //        treels_logl.push_back(pllUFBootDataPtr->treels_logl[i]);
 
     //boot_trees
-    boot_trees.clear();
+    boot_tree_ids.resize(params->gbo_replicates, -1);
     for(int i = 0; i < params->gbo_replicates; i++)
-        boot_trees.push_back(pllUFBootDataPtr->boot_trees[i]);
+        if (pllUFBootDataPtr->boot_trees[i].empty())
+            setBootTree(i, -1);
+        else
+            setBootTree(i, getBootTopologyID(pllUFBootDataPtr->boot_trees[i]));
 
 }
 
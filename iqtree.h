@@ -23,6 +23,7 @@
 #define IQPTREE_H
 
 #include <set>
+#include <list>
 #include <map>
 #include <stack>
 #include <vector>
@@ -33,11 +34,15 @@
 #include "node.h"
 #include "candidateset.h"
 #include "pllnni.h"
+#include "bootweights.h"
 
 typedef std::map< string, double > mapString2Double;
 typedef std::multiset< double, std::less< double > > multiSetDB;
 typedef std::multiset< int, std::less< int > > MultiSetInt;
 
+/** number of iterations without new stable splits, after which the fast search switches to the full model */
+const int FAST_SEARCH_STABLE_ITERATIONS = 10;
+
 class RepLeaf {
 public:
     Node *leaf;
@@ -763,8 +768,8 @@ public:
     /** log-likelihood threshold (l_min) */
     double logl_cutoff;
 
-    /** vector of bootstrap alignments generated */
-    vector<BootValType* > boot_samples;
+    /** pattern weights of the bootstrap alignments generated */
+    BootWeights boot_samples;
 
     /** starting sample for UFBoot, used for MPI */
     int sample_start;
@@ -772,8 +777,33 @@ public:
     /** end sample for UFBoot, used for MPI */
     int sample_end;
 
-    /** newick string of corresponding bootstrap trees */
-    StrVector boot_trees;
+    /** topology ID (index into boot_topologies) of the bootstrap tree of each replicate, -1 if none yet */
+    IntVector boot_tree_ids;
+
+    /** distinct UFBoot topologies as newick strings with taxon IDs, empty once no replicate refers to it */
+    StrVector boot_topologies;
+
+    /** released slots of boot_topologies, reused by getBootTopologyID */
+    IntVector boot_topology_free;
+
+    /** map from newick string to index in boot_topologies */
+    StringIntMap boot_topology_index;
+
+    /** number of replicates referring to each topology */
+    IntVector boot_topology_counts;
+
+    /** splits of each topology, as indices into boot_split_list */
+    vector<IntVector> boot_topology_splits;
+
+    /** distinct splits of all UFBoot topologies, split weight is the number of replicates containing it,
+        NULL for a released slot */
+    vector<Split*> boot_split_list;
+
+    /** released slots of boot_split_list, reused by getBootTopologyID */
+    IntVector boot_split_free;
+
+    /** map from split to its index in boot_split_list */
+    SplitIntMap boot_split_index;
 
     /** bootstrap tree strings with branch lengths, for -wbtl option */
     StrVector boot_trees_brlen;
@@ -804,6 +834,25 @@ public:
     /** summarize bootstrap trees into split set */
     void summarizeBootstrap(SplitGraph &sg);
 
+    /**
+     * look up a topology in the UFBoot topology table, inserting it if new
+     * @param tree_str newick string with taxon IDs and sorted taxa
+     * @return topology ID
+     */
+    int getBootTopologyID(const string &tree_str);
+
+    /**
+     * assign a topology to a bootstrap replicate and update topology and split frequencies
+     * @param sample replicate ID
+     * @param tree_id topology ID, -1 for none
+     */
+    void setBootTree(int sample, int tree_id);
+
+    /** @return newick string of the bootstrap tree of a replicate, empty if none */
+    string getBootTree(int sample) {
+        return (boot_tree_ids[sample] < 0) ? "" : boot_topologies[boot_tree_ids[sample]];
+    }
+
     void writeUFBootTrees(Params &params);
 
     /** @return bootstrap correlation coefficient for assessing convergence */
@@ -850,6 +899,67 @@ protected:
     // true if best candidate tree is changed
     bool bestcandidate_changed;
 
+    /** an NNI-optimal tree found by an earlier NNI search */
+    struct NNIOptimalTopo {
+        /** topology hash, see PhyloTree::getTopologyHash() */
+        uint64_t hash;
+        /** log-likelihood */
+        double score;
+        /** topology string, to rule out hash collisions */
+        string topology;
+        /** tree string with optimized branch lengths */
+        string tree;
+    };
+
+    /**
+     *  NNI-optimal trees found so far, most recently used first. An NNI search that reaches
+     *  one of these topologies stops and takes over the stored tree and score.
+     *  The list keeps at most as many trees as the candidate set (params->maxCandidates).
+     */
+    list<NNIOptimalTopo> nni_optimal_list;
+
+    /** index of nni_optimal_list by topology hash */
+    unordered_map<uint64_t, list<NNIOptimalTopo>::iterator> nni_optimal_topos;
+
+    /**
+     *  store the current tree as NNI-optimal, dropping the least recently used tree if the list is full
+     *  @param score log-likelihood of the current tree
+     */
+    void addNNIOptimalTopo(double score);
+
+    /**
+     *  load the stored NNI-optimal tree with the same topology as the current tree
+     *  @param score[out] log-likelihood of the stored tree
+     *  @return TRUE if found, FALSE if the current topology was not stored
+     */
+    bool loadNNIOptimalTopo(double &score);
+
+    /** number of NNI searches stopped at an already visited topology */
+    int num_known_topo_hits;
+
+    /**
+     *  number of Gamma categories of the full model during the fast search phase (-fastcat),
+     *  0 if the full model is in use
+     */
+    int fast_search_full_ncat;
+
+    /** highest number of stable splits seen during the fast search phase */
+    int fast_search_stable_splits;
+
+    /** iteration at which fast_search_stable_splits last increased */
+    int fast_search_stable_iter;
+
+    /**
+     *  switch between the reduced Gamma model of the fast search phase and the full model.
+     *  The candidate trees are re-scored under the new model. Switching back to the full model
+     *  re-optimizes the model parameters and polishes the best tree by an NNI search.
+     *  @param fast true to switch to the reduced model
+     */
+    void switchFastSearchModel(bool fast);
+
+    /** TRUE once the search has been intensified because the -deadline budget is nearly used up */
+    bool budget_endgame;
+
     /**
             number of IQPNNI iterations
      */
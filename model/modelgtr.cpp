@@ -24,6 +24,9 @@
 //const double MIN_FREQ_RATIO = MIN_FREQUENCY;
 //const double MAX_FREQ_RATIO = 1.0/MIN_FREQUENCY;
 
+/** minimum number of rate parameters to use the analytic gradient in derivativeFunk() */
+const int MIN_ANALYTIC_GRADIENT_RATES = 16;
+
 ModelGTR::ModelGTR(PhyloTree *tree, bool count_rates)
  : ModelSubst(tree->aln->num_states), EigenDecomposition()
 {
@@ -408,6 +411,38 @@ void ModelGTR::getQMatrix(double *q_mat) {
 
 }
 
+void ModelGTR::getNormalizedQMatrix(double *q_mat) {
+	double **rate_matrix = new double*[num_states];
+	double *freq = new double[num_states];
+	int i, j, k;
+	double sum = 0.0;
+
+	for (i = 0; i < num_states; i++)
+		sum += state_freq[i];
+	for (i = 0; i < num_states; i++)
+		freq[i] = state_freq[i] / sum;
+
+	for (i = 0; i < num_states; i++)
+		rate_matrix[i] = new double[num_states];
+
+	for (i = 0, k = 0; i < num_states; i++) {
+		rate_matrix[i][i] = 0.0;
+		for (j = i+1; j < num_states; j++, k++) {
+			rate_matrix[i][j] = rates[k];
+			rate_matrix[j][i] = rates[k];
+		}
+	}
+
+	computeRateMatrix(rate_matrix, freq, num_states);
+	for (i = 0; i < num_states; i++)
+		memcpy(q_mat + (i*num_states), rate_matrix[i], num_states * sizeof(double));
+
+	for (i = num_states-1; i >= 0; i--)
+		delete [] rate_matrix[i];
+	delete [] rate_matrix;
+	delete [] freq;
+}
+
 int ModelGTR::getNDim() { 
 	assert(freq_type != FREQ_UNKNOWN);
 	int ndim = num_params;
@@ -517,6 +552,67 @@ double ModelGTR::targetFunk(double x[]) {
 	return -phylo_tree->computeLikelihood();
 }
 
+double ModelGTR::derivativeFunk(double x[], double dfx[]) {
+	int ndim = getNDim();
+	int nrate = (freq_type == FREQ_ESTIMATE) ? ndim-(num_states-1) : ndim;
+	// one gradient pass costs about a dozen likelihood evaluations, finite differences one per parameter
+	if (!half_matrix || !isReversible() || nrate < MIN_ANALYTIC_GRADIENT_RATES || phylo_tree->getModel() != this)
+		return Optimization::derivativeFunk(x, dfx);
+
+	// same relative step as Optimization::derivativeFunk()
+	const double step = 1.0e-4;
+	int i, dim, first_numeric = 1;
+	double fx = targetFunk(x);
+
+	// states of (near) zero frequency are taken out of the eigensystem, the gradient does not hold for them
+	double freq_sum = 0.0, min_freq = state_freq[0];
+	for (i = 0; i < num_states; i++) {
+		freq_sum += state_freq[i];
+		min_freq = min(min_freq, state_freq[i]);
+	}
+
+	int nsq = num_states*num_states;
+	double *dlnl_dq = new double[nsq];
+	if (fx < 1.0e+12 && min_freq > 1e-6*freq_sum && phylo_tree->computeQMatrixGradient(dlnl_dq)) {
+		// chain rule through the rate matrix, which is cheap to differentiate numerically
+		double *q_plus = new double[nsq];
+		double *q_minus = new double[nsq];
+		for (dim = 1; dim <= nrate; dim++) {
+			double temp = x[dim];
+			double h = step * fabs(temp);
+			if (h == 0.0) h = step;
+			x[dim] = temp + h;
+			getVariables(x);
+			getNormalizedQMatrix(q_plus);
+			x[dim] = temp - h;
+			getVariables(x);
+			getNormalizedQMatrix(q_minus);
+			x[dim] = temp;
+			double grad = 0.0;
+			for (i = 0; i < nsq; i++)
+				grad += dlnl_dq[i] * (q_plus[i] - q_minus[i]);
+			dfx[dim] = -grad / (2.0*h);
+		}
+		getVariables(x);
+		delete [] q_minus;
+		delete [] q_plus;
+		first_numeric = nrate+1;
+	}
+	delete [] dlnl_dq;
+
+	// state frequencies also enter the root distribution
+	for (dim = first_numeric; dim <= ndim; dim++) {
+		double temp = x[dim];
+		double h = step * fabs(temp);
+		if (h == 0.0) h = step;
+		x[dim] = temp + h;
+		h = x[dim] - temp;
+		dfx[dim] = (targetFunk(x) - fx) / h;
+		x[dim] = temp;
+	}
+	return fx;
+}
+
 bool ModelGTR::isUnstableParameters() {
 	int nrates = getNumRateEntries();
 	int i;
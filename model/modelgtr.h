@@ -202,6 +202,12 @@ public:
 	 */
 	virtual void getQMatrix(double *q_mat);
 
+	/**
+		get the rate matrix normalised as in decomposeRateMatrix(), i.e. with state frequencies summing to 1
+		@param q_mat (OUT) the rate matrix
+	*/
+	void getNormalizedQMatrix(double *q_mat);
+
 	/**
 		rescale the state frequencies
 		@param sum_one TRUE to make frequencies sum to 1, FALSE to make last entry equal to 1
@@ -255,6 +261,15 @@ public:
 	*/
 	virtual double targetFunk(double x[]);
 
+	/**
+		gradient of targetFunk. Rate parameters are derived from the rate matrix gradient of the
+		tree, state frequencies and unsupported cases by finite differences
+		@param x the input vector x
+		@param dfx (OUT) the derivatives at x
+		@return the function value at x
+	*/
+	virtual double derivativeFunk(double x[], double dfx[]);
+
 	/**
 	 * setup the bounds for joint optimization with BFGS
 	 */
@@ -1401,72 +1401,122 @@ double ModelMixture::targetFunk(double x[]) {
 double ModelMixture::optimizeWeights() {
     // first compute _pattern_lh_cat
     phylo_tree->computePatternLhCat(WSL_MIXTURE);
-    size_t ptn, c;
-    size_t nptn = phylo_tree->aln->getNPattern();
+    size_t c;
     size_t nmix = getNMixtures();
     
-    double *new_prop = aligned_alloc<double>(nmix);
+    // weights at the start of a cycle, after one and after two EM steps, and the extrapolation
+    double *weight0 = aligned_alloc<double>(nmix);
+    double *weight1 = aligned_alloc<double>(nmix);
+    double *weight2 = aligned_alloc<double>(nmix);
+    double *weight_acc = aligned_alloc<double>(nmix);
+    double *weight_next = aligned_alloc<double>(nmix);
     double *ratio_prop = aligned_alloc<double>(nmix);
+    double old_pinvar = phylo_tree->getRate()->getPInvar();
 
-    // EM algorithm loop described in Wang, Li, Susko, and Roger (2008)
-    for (int step = 0; step < nmix; step++) {
-        // E-step
+    memcpy(weight0, prop, nmix*sizeof(double));
 
-        if (step > 0) {
-            // convert _pattern_lh_cat taking into account new weights
-            for (ptn = 0; ptn < nptn; ptn++) {
-                double *this_lk_cat = phylo_tree->_pattern_lh_cat + ptn*nmix;
-                for (c = 0; c < nmix; c++) {
-                    this_lk_cat[c] *= ratio_prop[c];
-                }
-            } 
+    // EM algorithm loop described in Wang, Li, Susko, and Roger (2008). _pattern_lh_cat stays fixed,
+    // so every two EM steps are extrapolated by SQUAREM (Varadhan and Roland 2008)
+    for (int step = 0; step < nmix; step++) {
+        computeWeightEMStep(weight0, weight1, ratio_prop, old_pinvar);
+        if (isWeightConverged(weight0, weight1)) {
+            memcpy(weight0, weight1, nmix*sizeof(double));
+            break;
         }
-        memset(new_prop, 0, nmix*sizeof(double));
-        for (ptn = 0; ptn < nptn; ptn++) {
-            double *this_lk_cat = phylo_tree->_pattern_lh_cat + ptn*nmix;
-            double lk_ptn = phylo_tree->ptn_invar[ptn];
+        computeWeightEMStep(weight1, weight2, ratio_prop, old_pinvar);
+        if (isWeightConverged(weight1, weight2)) {
+            memcpy(weight0, weight2, nmix*sizeof(double));
+            break;
+        }
+        double rr = 0.0, vv = 0.0;
+        for (c = 0; c < nmix; c++) {
+            double r = weight1[c] - weight0[c];
+            double v = weight2[c] - weight1[c] - r;
+            rr += r*r;
+            vv += v*v;
+        }
+        // alpha = -1 gives back weight2, move towards it until the extrapolation is feasible
+        double alpha = (vv > 0.0) ? -sqrt(rr/vv) : -1.0;
+        bool feasible = false;
+        for (int trial = 0; trial < 5 && alpha < -1.0 && !feasible; trial++) {
+            feasible = true;
             for (c = 0; c < nmix; c++) {
-                lk_ptn += this_lk_cat[c];
+                double r = weight1[c] - weight0[c];
+                double v = weight2[c] - weight1[c] - r;
+                weight_acc[c] = weight0[c] - 2*alpha*r + alpha*alpha*v;
+                if (weight_acc[c] < 1e-10)
+                    feasible = false;
             }
-            assert(lk_ptn != 0.0);
-            lk_ptn = phylo_tree->ptn_freq[ptn] / lk_ptn;
+            if (!feasible)
+                alpha = (alpha-1.0)/2;
+        }
+        if (feasible) {
+            // keep the sum of weight2, leaving p_invar to the EM steps
+            double sum2 = 0.0, sum_acc = 0.0;
             for (c = 0; c < nmix; c++) {
-                new_prop[c] += this_lk_cat[c] * lk_ptn;
-            }
-        } 
-        bool converged = true;
-        double new_pinvar = 0.0;    
-        for (c = 0; c < nmix; c++) {
-            new_prop[c] /= phylo_tree->getAlnNSite();
-            // Make sure that probabilities do not get zero
-            if (new_prop[c] < 1e-10) new_prop[c] = 1e-10;
-            // check for convergence
-            converged = converged && (fabs(prop[c]-new_prop[c]) < 1e-4);
-            ratio_prop[c] = new_prop[c] / prop[c];
-            if (std::isnan(ratio_prop[c])) {
-                cerr << "BUG: " << new_prop[c] << " " << prop[c] << " " << ratio_prop[c] << endl;
+                sum2 += weight2[c];
+                sum_acc += weight_acc[c];
             }
-            prop[c] = new_prop[c];
-            new_pinvar += prop[c];
-        }
-        new_pinvar = 1.0 - new_pinvar;
-        if (new_pinvar != 0.0) {
-            converged = converged && (fabs(phylo_tree->getRate()->getPInvar()-new_pinvar) < 1e-4);
-            phylo_tree->getRate()->setPInvar(new_pinvar);
-            phylo_tree->getRate()->setOptimizePInvar(false);
-            phylo_tree->computePtnInvar();
-            
+            for (c = 0; c < nmix; c++)
+                weight_acc[c] *= sum2/sum_acc;
         }
-        if (converged) break;
+        // one more EM step from the extrapolation keeps the iteration stable
+        double logl = computeWeightEMStep(weight2, weight_next, ratio_prop, old_pinvar);
+        if (feasible && computeWeightEMStep(weight_acc, weight0, ratio_prop, old_pinvar) > logl)
+            continue;
+        memcpy(weight0, weight_next, nmix*sizeof(double));
+    }
 
+    double new_pinvar = 0.0;
+    for (c = 0; c < nmix; c++) {
+        prop[c] = weight0[c];
+        new_pinvar += prop[c];
+    }
+    new_pinvar = 1.0 - new_pinvar;
+    if (new_pinvar != 0.0) {
+        phylo_tree->getRate()->setPInvar(new_pinvar);
+        phylo_tree->getRate()->setOptimizePInvar(false);
+        phylo_tree->computePtnInvar();
     }
     
     aligned_free(ratio_prop);
-    aligned_free(new_prop);
-//    aligned_free(lk_ptn);
+    aligned_free(weight_next);
+    aligned_free(weight_acc);
+    aligned_free(weight2);
+    aligned_free(weight1);
+    aligned_free(weight0);
     return phylo_tree->computeLikelihood();
 }
 
+double ModelMixture::computeWeightEMStep(double *weight, double *new_weight, double *ratio_prop, double old_pinvar) {
+    size_t c, nmix = getNMixtures();
+    // _pattern_lh_cat was computed with prop and old_pinvar
+    double sum = 0.0;
+    for (c = 0; c < nmix; c++) {
+        ratio_prop[c] = weight[c] / prop[c];
+        sum += weight[c];
+    }
+    double ratio_pinvar = (old_pinvar != 0.0) ? (1.0 - sum) / old_pinvar : 1.0;
+    double logl = phylo_tree->computeEMWeights(phylo_tree->_pattern_lh_cat, nmix, ratio_prop, ratio_pinvar, new_weight);
+    // Make sure that probabilities do not get zero
+    for (c = 0; c < nmix; c++)
+        if (new_weight[c] < 1e-10) new_weight[c] = 1e-10;
+    return logl;
+}
+
+bool ModelMixture::isWeightConverged(double *weight, double *new_weight) {
+    size_t c, nmix = getNMixtures();
+    double sum = 0.0, new_sum = 0.0;
+    bool converged = true;
+    for (c = 0; c < nmix; c++) {
+        converged = converged && (fabs(weight[c]-new_weight[c]) < 1e-4);
+        sum += weight[c];
+        new_sum += new_weight[c];
+    }
+    // p_invar is 1 minus the sum of weights
+    return converged && (fabs(sum-new_sum) < 1e-4);
+}
+
 double ModelMixture::optimizeWithEM(double gradient_epsilon) {
     size_t ptn, c;
     size_t nptn = phylo_tree->aln->getNPattern();
@@ -1505,25 +1555,9 @@ double ModelMixture::optimizeWithEM(double gradient_epsilon) {
         // first compute _pattern_lh_cat
         score = phylo_tree->computePatternLhCat(WSL_MIXTURE);
         
-        memset(new_prop, 0, nmix*sizeof(double));
-                
         // E-step
-        // decoupled weights (prop) from _pattern_lh_cat to obtain L_ci and compute pattern likelihood L_i
-        for (ptn = 0; ptn < nptn; ptn++) {
-            double *this_lk_cat = phylo_tree->_pattern_lh_cat + ptn*nmix;
-            double lk_ptn = phylo_tree->ptn_invar[ptn];
-            for (c = 0; c < nmix; c++) {
-                lk_ptn += this_lk_cat[c];
-            }
-            assert(lk_ptn != 0.0);
-            lk_ptn = phylo_tree->ptn_freq[ptn] / lk_ptn;
-            
-            // transform _pattern_lh_cat into posterior probabilities of each category
-            for (c = 0; c < nmix; c++) {
-                this_lk_cat[c] *= lk_ptn;
-                new_prop[c] += this_lk_cat[c];
-            }
-        } 
+        // _pattern_lh_cat already contains the weights (prop), transform it into posterior probabilities
+        phylo_tree->computeEMWeights(phylo_tree->_pattern_lh_cat, nmix, NULL, 1.0, new_prop, phylo_tree->_pattern_lh_cat);
         
         // M-step, update weights according to (*)        
         
@@ -1532,7 +1566,6 @@ double ModelMixture::optimizeWithEM(double gradient_epsilon) {
         if (!fix_prop) {
             double new_pinvar = 0.0;
             for (c = 0; c < nmix; c++) {
-                new_prop[c] = new_prop[c] / phylo_tree->getAlnNSite();
                 if (new_prop[c] < 1e-10) new_prop[c] = 1e-10;
                 // check for convergence
                 converged = converged && (fabs(prop[c]-new_prop[c]) < 1e-4);
@@ -115,6 +115,21 @@ public:
     */
     double optimizeWeights();
 
+    /**
+        one EM step of optimizeWeights() for the _pattern_lh_cat computed with the current weights
+        @param weight weights to start from
+        @param[out] new_weight updated weights
+        @param ratio_prop buffer of getNMixtures() entries
+        @param old_pinvar proportion of invariable sites that _pattern_lh_cat was computed with
+        @return log-likelihood at weight
+    */
+    double computeWeightEMStep(double *weight, double *new_weight, double *ratio_prop, double old_pinvar);
+
+    /**
+        @return TRUE if weights and proportion of invariable sites changed by less than 1e-4
+    */
+    bool isWeightConverged(double *weight, double *new_weight);
+
     /** 
         optimize rate parameters using EM algorithm
         @param gradient_epsilon
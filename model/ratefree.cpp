@@ -450,13 +450,6 @@ void RateFree::writeParameters(ostream &out) {
 }
 
 double RateFree::optimizeWithEM() {
-    size_t ptn, c;
-    size_t nptn = phylo_tree->aln->getNPattern();
-    size_t nmix = ncategory;
-    const double MIN_PROP = 1e-4;
-    
-//    double *lk_ptn = aligned_alloc<double>(nptn);
-    double *new_prop = aligned_alloc<double>(nmix);
     PhyloTree *tree = new PhyloTree;
 
     // attach memory to save space
@@ -480,123 +473,79 @@ double RateFree::optimizeWithEM() {
     model_fac->site_rate = site_rate;
     tree->model_factory = model_fac;
     tree->setParams(phylo_tree->params);
-    double old_score = 0.0;
-    // EM algorithm loop described in Wang, Li, Susko, and Roger (2008)
-    for (int step = 0; step < ncategory; step++) {
-        // first compute _pattern_lh_cat
-        double score;
-        score = phylo_tree->computePatternLhCat(WSL_RATECAT);
-        if (score > 0.0) {
-            phylo_tree->printTree(cout, WT_BR_LEN+WT_NEWLINE);
-            writeInfo(cout);
-        }
-        assert(score < 0);
-        
+
+    // proportions followed by rates, at the start of a cycle, after one and after two EM steps
+    const double MIN_PROP = 1e-4;
+    int c, nparam = 2*ncategory;
+    double *theta0 = new double[5*nparam];
+    double *theta1 = theta0 + nparam;
+    double *theta2 = theta0 + 2*nparam;
+    double *r = theta0 + 3*nparam;
+    double *v = theta0 + 4*nparam;
+    double score, old_score = 0.0;
+
+    // EM algorithm loop described in Wang, Li, Susko, and Roger (2008),
+    // two EM steps are then extrapolated by SQUAREM (Varadhan and Roland 2008)
+    for (int step = 0; step < ncategory; ) {
+        getEMParameters(theta0);
+        int status = doEMStep(tree, score);
         if (step > 0)
             assert(score > old_score-0.1);
-            
         old_score = score;
-        
-        memset(new_prop, 0, nmix*sizeof(double));
-                
-        // E-step
-        // decoupled weights (prop) from _pattern_lh_cat to obtain L_ci and compute pattern likelihood L_i
-        for (ptn = 0; ptn < nptn; ptn++) {
-            double *this_lk_cat = phylo_tree->_pattern_lh_cat + ptn*nmix;
-            double lk_ptn = phylo_tree->ptn_invar[ptn];
-            for (c = 0; c < nmix; c++) {
-                lk_ptn += this_lk_cat[c];
-            }
-            assert(lk_ptn != 0.0);
-            lk_ptn = phylo_tree->ptn_freq[ptn] / lk_ptn;
-            
-            // transform _pattern_lh_cat into posterior probabilities of each category
-            for (c = 0; c < nmix; c++) {
-                this_lk_cat[c] *= lk_ptn;
-                new_prop[c] += this_lk_cat[c];
-            }
-            
-        } 
-        
-        // M-step, update weights according to (*)        
-        int maxpropid = 0;
-        double new_pinvar = 0.0;    
-        for (c = 0; c < nmix; c++) {
-            new_prop[c] = new_prop[c] / phylo_tree->getAlnNSite();
-            if (new_prop[c] > new_prop[maxpropid])
-                maxpropid = c;
+        if (status != 0 || ++step >= ncategory)
+            break;
+
+        getEMParameters(theta1);
+        status = doEMStep(tree, score);
+        assert(score > old_score-0.1);
+        old_score = score;
+        step++;
+        if (status != 0)
+            break;
+
+        getEMParameters(theta2);
+        double rr = 0.0, vv = 0.0;
+        for (c = 0; c < nparam; c++) {
+            r[c] = theta1[c] - theta0[c];
+            v[c] = theta2[c] - theta1[c] - r[c];
+            rr += r[c]*r[c];
+            vv += v[c]*v[c];
         }
-        // regularize prop
-        bool zero_prop = false;
-        for (c = 0; c < nmix; c++) {
-            if (new_prop[c] < MIN_PROP) {
-                new_prop[maxpropid] -= (MIN_PROP - new_prop[c]);
-                new_prop[c] = MIN_PROP;
-                zero_prop = true;
+        if (vv == 0.0)
+            continue;
+        // extrapolate into theta1, alpha = -1 gives back theta2, move towards it until feasible
+        double alpha = -sqrt(rr/vv);
+        bool feasible = false;
+        for (int trial = 0; trial < 5 && alpha < -1.0 && !feasible; trial++) {
+            feasible = true;
+            for (c = 0; c < nparam; c++) {
+                theta1[c] = theta0[c] - 2*alpha*r[c] + alpha*alpha*v[c];
+                if (theta1[c] < ((c < ncategory) ? MIN_PROP : MIN_FREE_RATE))
+                    feasible = false;
             }
+            if (!feasible)
+                alpha = (alpha-1.0)/2;
         }
-        // break if some probabilities too small
-        if (zero_prop) break;
-        
-        bool converged = true;
-        double sum_prop = 0.0;
-        for (c = 0; c < nmix; c++) {
-//            new_prop[c] = new_prop[c] / phylo_tree->getAlnNSite();
-            // check for convergence
-            sum_prop += new_prop[c];
-            converged = converged && (fabs(prop[c]-new_prop[c]) < 1e-4);
-            prop[c] = new_prop[c];
-            new_pinvar += new_prop[c];
+        if (!feasible)
+            continue;
+        // proportions keep the sum of theta2, leaving p_invar unchanged
+        double sum2 = 0.0, sum1 = 0.0;
+        for (c = 0; c < ncategory; c++) {
+            sum2 += theta2[c];
+            sum1 += theta1[c];
         }
+        for (c = 0; c < ncategory; c++)
+            theta1[c] *= sum2/sum1;
 
-        new_pinvar = 1.0 - new_pinvar;
-
-        if (new_pinvar > 1e-4 && getPInvar() != 0.0) {
-            converged = converged && (fabs(getPInvar()-new_pinvar) < 1e-4);
-            setPInvar(new_pinvar);
-//            setOptimizePInvar(false);
-            phylo_tree->computePtnInvar();
-        }
-        
-        assert(fabs(sum_prop+new_pinvar-1.0) < MIN_PROP);
-        
-        // now optimize rates one by one
-        double sum = 0.0;
-        for (c = 0; c < nmix; c++) {
-            tree->copyPhyloTree(phylo_tree);
-            ModelGTR *subst_model;
-            if (phylo_tree->getModel()->isMixture() && phylo_tree->getModelFactory()->fused_mix_rate)
-                subst_model = ((ModelMixture*)phylo_tree->getModel())->at(c);
-            else
-                subst_model = (ModelGTR*)phylo_tree->getModel();
-            tree->setModel(subst_model);
-            subst_model->setTree(tree);
-            model_fac->model = subst_model;
-            if (subst_model->isMixture() || subst_model->isSiteSpecificModel())
-                tree->setLikelihoodKernel(phylo_tree->sse, phylo_tree->num_threads);
-
-                        
-            // initialize likelihood
-            tree->initializeAllPartialLh();
-            // copy posterior probability into ptn_freq
-            tree->computePtnFreq();
-            double *this_lk_cat = phylo_tree->_pattern_lh_cat+c;
-            for (ptn = 0; ptn < nptn; ptn++)
-                tree->ptn_freq[ptn] = this_lk_cat[ptn*nmix];
-            double scaling = rates[c];
-            tree->scaleLength(scaling);
-            tree->optimizeTreeLengthScaling(MIN_PROP, scaling, 1.0/prop[c], 0.001);
-            converged = converged && (fabs(rates[c] - scaling) < 1e-4);
-            rates[c] = scaling;
-            sum += prop[c] * rates[c];
-            // reset subst model
-            tree->setModel(NULL);
-            subst_model->setTree(phylo_tree);
-            
-        }
-        
+        double score2 = phylo_tree->computeLikelihood();
+        setEMParameters(theta1);
         phylo_tree->clearAllPartialLH();
-        if (converged) break;
+        score = phylo_tree->computeLikelihood();
+        if (score < score2) {
+            // extrapolation failed, continue from the plain EM step
+            setEMParameters(theta2);
+            phylo_tree->clearAllPartialLH();
+        }
     }
     
     // deattach memory
@@ -604,7 +553,118 @@ double RateFree::optimizeWithEM() {
 //    tree->central_scale_num = NULL;
 //    tree->central_partial_pars = NULL;
 
+    delete [] theta0;
     delete tree;
-    aligned_free(new_prop);
     return phylo_tree->computeLikelihood();
 }
+
+void RateFree::getEMParameters(double *theta) {
+    memcpy(theta, prop, ncategory*sizeof(double));
+    memcpy(theta+ncategory, rates, ncategory*sizeof(double));
+}
+
+void RateFree::setEMParameters(double *theta) {
+    memcpy(prop, theta, ncategory*sizeof(double));
+    memcpy(rates, theta+ncategory, ncategory*sizeof(double));
+}
+
+int RateFree::doEMStep(PhyloTree *tree, double &score) {
+    size_t ptn, c;
+    size_t nptn = phylo_tree->aln->getNPattern();
+    size_t nmix = ncategory;
+    const double MIN_PROP = 1e-4;
+    double *new_prop = aligned_alloc<double>(nmix);
+
+    // first compute _pattern_lh_cat
+    score = phylo_tree->computePatternLhCat(WSL_RATECAT);
+    if (score > 0.0) {
+        phylo_tree->printTree(cout, WT_BR_LEN+WT_NEWLINE);
+        writeInfo(cout);
+    }
+    assert(score < 0);
+
+    // E-step
+    // _pattern_lh_cat already contains the weights (prop), transform it into posterior probabilities
+    phylo_tree->computeEMWeights(phylo_tree->_pattern_lh_cat, nmix, NULL, 1.0, new_prop, phylo_tree->_pattern_lh_cat);
+
+    // M-step, update weights according to (*)        
+    int maxpropid = 0;
+    double new_pinvar = 0.0;    
+    for (c = 0; c < nmix; c++) {
+        if (new_prop[c] > new_prop[maxpropid])
+            maxpropid = c;
+    }
+    // regularize prop
+    bool zero_prop = false;
+    for (c = 0; c < nmix; c++) {
+        if (new_prop[c] < MIN_PROP) {
+            new_prop[maxpropid] -= (MIN_PROP - new_prop[c]);
+            new_prop[c] = MIN_PROP;
+            zero_prop = true;
+        }
+    }
+    // break if some probabilities too small
+    if (zero_prop) {
+        aligned_free(new_prop);
+        return -1;
+    }
+    
+    bool converged = true;
+    double sum_prop = 0.0;
+    for (c = 0; c < nmix; c++) {
+        // check for convergence
+        sum_prop += new_prop[c];
+        converged = converged && (fabs(prop[c]-new_prop[c]) < 1e-4);
+        prop[c] = new_prop[c];
+        new_pinvar += new_prop[c];
+    }
+
+    new_pinvar = 1.0 - new_pinvar;
+
+    if (new_pinvar > 1e-4 && getPInvar() != 0.0) {
+        converged = converged && (fabs(getPInvar()-new_pinvar) < 1e-4);
+        setPInvar(new_pinvar);
+//        setOptimizePInvar(false);
+        phylo_tree->computePtnInvar();
+    }
+    
+    assert(fabs(sum_prop+new_pinvar-1.0) < MIN_PROP);
+    
+    // now optimize rates one by one
+    ModelFactory *model_fac = tree->getModelFactory();
+    for (c = 0; c < nmix; c++) {
+        tree->copyPhyloTree(phylo_tree);
+        ModelGTR *subst_model;
+        if (phylo_tree->getModel()->isMixture() && phylo_tree->getModelFactory()->fused_mix_rate)
+            subst_model = ((ModelMixture*)phylo_tree->getModel())->at(c);
+        else
+            subst_model = (ModelGTR*)phylo_tree->getModel();
+        tree->setModel(subst_model);
+        subst_model->setTree(tree);
+        model_fac->model = subst_model;
+        if (subst_model->isMixture() || subst_model->isSiteSpecificModel())
+            tree->setLikelihoodKernel(phylo_tree->sse, phylo_tree->num_threads);
+
+                    
+        // initialize likelihood
+        tree->initializeAllPartialLh();
+        // copy posterior probability into ptn_freq
+        tree->computePtnFreq();
+        double *this_lk_cat = phylo_tree->_pattern_lh_cat+c;
+        for (ptn = 0; ptn < nptn; ptn++)
+            tree->ptn_freq[ptn] = this_lk_cat[ptn*nmix];
+        double scaling = rates[c];
+        tree->scaleLength(scaling);
+        tree->optimizeTreeLengthScaling(MIN_PROP, scaling, 1.0/prop[c], 0.001);
+        converged = converged && (fabs(rates[c] - scaling) < 1e-4);
+        rates[c] = scaling;
+        // reset subst model
+        tree->setModel(NULL);
+        subst_model->setTree(phylo_tree);
+        
+    }
+    
+    phylo_tree->clearAllPartialLH();
+    aligned_free(new_prop);
+    return (converged) ? 1 : 0;
+}
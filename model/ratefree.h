@@ -73,6 +73,15 @@ public:
     */
     double optimizeWithEM();
 
+    /**
+        one EM step: compute the posterior probabilities of the categories, update the proportions
+        and optimize the rate of every category on a copy of the tree
+        @param tree helper tree for the rate optimization
+        @param[out] score log-likelihood before the update
+        @return 1 if converged, -1 if a proportion became too small (nothing is updated), 0 otherwise
+    */
+    int doEMStep(PhyloTree *tree, double &score);
+
 	/**
 		return the number of dimensions
 	*/
@@ -130,6 +139,18 @@ protected:
 	*/
 	virtual bool getVariables(double *variables);
 
+	/**
+		copy the proportions followed by the rates into theta, used for the EM acceleration
+		@param theta (OUT) vector of 2*ncategory entries
+	*/
+	void getEMParameters(double *theta);
+
+	/**
+		assign the proportions followed by the rates from theta
+		@param theta vector of 2*ncategory entries
+	*/
+	void setEMParameters(double *theta);
+
 	/**
 	 * proportion of sites for each rate categories
 	 */
@@ -650,6 +650,23 @@ void MTree::readTreeString(string tree_string, bool is_rooted) {
 
 
 void MTree::readTree(istream &in, bool &is_rooted)
+{
+    try {
+        parseTree(in, is_rooted);
+    } catch (bad_alloc) {
+        outError(ERR_NO_MEMORY);
+    } catch (string str) {
+        outError(str);
+    }
+
+    nodeNum = leafNum;
+    initializeTree();
+
+    //bool stop = false;
+    //checkValidTree(stop);
+}
+
+void MTree::parseTree(istream &in, bool &is_rooted)
 {
     in_line = 1;
     in_column = 1;
@@ -688,23 +705,17 @@ void MTree::readTree(istream &in, bool &is_rooted)
         if (in.eof() || ch != ';')
             throw "Tree file must be ended with a semi-colon ';'";
     } catch (bad_alloc) {
-        outError(ERR_NO_MEMORY);
+        throw;
     } catch (const char *str) {
-        outError(str, reportInputInfo());
+        throw str + reportInputInfo();
     } catch (string str) {
-        outError(str.c_str(), reportInputInfo());
+        throw str + reportInputInfo();
     } catch (ios::failure) {
-        outError(ERR_READ_INPUT, reportInputInfo());
+        throw ERR_READ_INPUT + reportInputInfo();
     } catch (...) {
         // anything else
-        outError(ERR_READ_ANY, reportInputInfo());
+        throw ERR_READ_ANY + reportInputInfo();
     }
-
-    nodeNum = leafNum;
-    initializeTree();
-
-    //bool stop = false;
-    //checkValidTree(stop);
 }
 
 void MTree::initializeTree(Node *node, Node* dad)
@@ -283,6 +283,15 @@ public:
      */
     virtual void readTree(istream &in, bool &is_rooted);
 
+    /**
+            parse the tree from the ifstream in newick format like readTree(), but without
+            initializing the node IDs and without quitting the program on a malformed tree
+            @param in the input stream.
+            @param is_rooted (IN/OUT) true if tree is rooted
+            @throw string error message with the position in the input, or bad_alloc
+     */
+    void parseTree(istream &in, bool &is_rooted);
+
     /**
             read the tree from a newick string
             @param tree_string the tree string.
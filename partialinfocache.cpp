@@ -0,0 +1,74 @@
+/***************************************************************************
+ *   Copyright (C) 2009-2015 by                                            *
+ *   BUI Quang Minh <minh.bui@univie.ac.at>                                *
+ *   Lam-Tung Nguyen <nltung@gmail.com>                                    *
+ *                                                                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include "partialinfocache.h"
+
+PartialInfoCache::PartialInfoCache() {
+	hits = misses = 0;
+	entry_size = 0;
+	version = 0;
+	num_slots = 0;
+	data = NULL;
+}
+
+PartialInfoCache::~PartialInfoCache() {
+	release();
+}
+
+void PartialInfoCache::init(int num_leaves, size_t entry_size, size_t max_mem) {
+	if (this->entry_size == entry_size && data)
+		return;
+	release();
+	this->entry_size = entry_size;
+	num_slots = min((size_t)num_leaves, max_mem / (entry_size*sizeof(double)));
+	if (num_slots <= 0)
+		return;
+	data = new double[num_slots*entry_size];
+	// no branch has length -1, so all slots start invalid
+	slot_version.assign(num_slots, version);
+	slot_length.assign(num_slots, -1.0);
+}
+
+void PartialInfoCache::release() {
+	if (data)
+		delete [] data;
+	data = NULL;
+	num_slots = 0;
+	slot_version.clear();
+	slot_length.clear();
+}
+
+bool PartialInfoCache::isValid(int leaf_id, double length) {
+	bool found = (slot_version[leaf_id] == version && slot_length[leaf_id] == length);
+	if (found) {
+#ifdef _OPENMP
+#pragma omp atomic
+#endif
+		hits++;
+	} else {
+#ifdef _OPENMP
+#pragma omp atomic
+#endif
+		misses++;
+	}
+	return found;
+}
@@ -0,0 +1,124 @@
+/***************************************************************************
+ *   Copyright (C) 2009-2015 by                                            *
+ *   BUI Quang Minh <minh.bui@univie.ac.at>                                *
+ *   Lam-Tung Nguyen <nltung@gmail.com>                                    *
+ *                                                                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifndef PARTIALINFOCACHE_H_
+#define PARTIALINFOCACHE_H_
+
+#include "tools.h"
+
+/** maximum memory of the tip partial likelihood cache in bytes */
+#define MAX_PARTIAL_INFO_CACHE (64*1024*1024)
+
+/**
+ * Cache of the tip partial likelihoods that PhyloTree::computePartialInfo()
+ * precomputes for a leaf child, i.e. the transition matrices of the branch for
+ * all rate categories applied to the tip likelihoods of all states. Every leaf
+ * has its own slot, which is valid for the model version and the branch length
+ * it was computed with. The partial likelihood kernel reads the slots in place.
+ * No locking is needed: a leaf is the child of only one node of a traversal, so
+ * its slot is written by one thread, and it is only read after all slots of the
+ * traversal have been computed. Leaves beyond the memory limit have no slot.
+ */
+class PartialInfoCache {
+public:
+
+	PartialInfoCache();
+
+	~PartialInfoCache();
+
+	/**
+	 * allocate the slots, nothing is done if the entry size did not change
+	 * @param num_leaves number of leaves of the tree
+	 * @param entry_size number of doubles of one entry
+	 * @param max_mem maximum memory in bytes
+	 */
+	void init(int num_leaves, size_t entry_size, size_t max_mem = MAX_PARTIAL_INFO_CACHE);
+
+	/** release the memory */
+	void release();
+
+	/** invalidate all entries, to be called whenever the model or the rates change */
+	void newVersion() { version++; }
+
+	/**
+	 * @param leaf_id leaf ID
+	 * @return slot of the leaf, NULL if the leaf has no slot
+	 */
+	double *getSlot(int leaf_id) {
+		return (leaf_id < num_slots) ? data + leaf_id*entry_size : NULL;
+	}
+
+	/**
+	 * @param leaf_id leaf ID
+	 * @param buffer entry to use if the leaf has no slot
+	 * @return entry of the leaf
+	 */
+	double *getEntry(int leaf_id, double *buffer) {
+		return (leaf_id < num_slots) ? data + leaf_id*entry_size : buffer;
+	}
+
+	/**
+	 * check if the slot of a leaf was computed with the current model version and branch length
+	 * @param leaf_id leaf ID, must have a slot
+	 * @param length branch length to the leaf
+	 * @return TRUE if the slot can be used as it is
+	 */
+	bool isValid(int leaf_id, double length);
+
+	/**
+	 * mark the slot of a leaf as computed with the current model version
+	 * @param leaf_id leaf ID, must have a slot
+	 * @param length branch length to the leaf
+	 */
+	void setValid(int leaf_id, double length) {
+		slot_version[leaf_id] = version;
+		slot_length[leaf_id] = length;
+	}
+
+	/** number of lookups that found their entry */
+	uint64_t hits;
+
+	/** number of lookups that did not find their entry */
+	uint64_t misses;
+
+protected:
+
+	/** number of doubles of one entry */
+	size_t entry_size;
+
+	/** current model version */
+	uint64_t version;
+
+	/** number of slots, leaves with a smaller ID have a slot */
+	int num_slots;
+
+	/** model version of every slot */
+	vector<uint64_t> slot_version;
+
+	/** branch length of every slot */
+	DoubleVector slot_length;
+
+	/** entries of all slots */
+	double *data;
+};
+
+#endif /* PARTIALINFOCACHE_H_ */
@@ -47,6 +47,7 @@
 #include "splitgraph.h"
 #include "circularnetwork.h"
 #include "mtreeset.h"
+#include "streamsplitset.h"
 #include "mexttree.h"
 #include "ncl/ncl.h"
 #include "msetsblock.h"
@@ -1435,6 +1436,71 @@ void computeRFDistExtended(const char *trees1, const char *trees2, const char *f
 
 }
 
+/**
+	print RF distances of rows [row_start, row_end) in the format of printRFDist()
+*/
+void printRFDistRows(ostream &out, int *rfdist, int row_start, int row_end, int m) {
+	for (int i = row_start; i < row_end; i++) {
+		out << "Tree" << i << "      ";
+		int *row = rfdist + (size_t)(i - row_start) * m;
+		for (int j = 0; j < m; j++)
+			out << " " << row[j];
+		out << endl;
+	}
+}
+
+/**
+	RF distances from split fingerprints, the distance matrix is computed and
+	written in blocks of rows, so that it never has to be kept in memory
+*/
+void computeRFDistFingerprint(Params &params, const char *filename) {
+	TreeFingerprintSet trees, treeset2;
+	TreeFingerprintSet *cols = &trees;
+	double weight_threshold = (params.rf_dist_mode == RF_TWO_TREE_SETS) ? -1000 : params.split_weight_threshold;
+	trees.readTrees(params.user_file, params.tree_burnin, params.tree_max_count, params.is_rooted, weight_threshold);
+	if (params.rf_dist_mode == RF_TWO_TREE_SETS) {
+		treeset2.readTrees(params.second_tree, params.tree_burnin, params.tree_max_count, params.is_rooted,
+				weight_threshold, &trees);
+		cols = &treeset2;
+		cout << "Computing Robinson-Foulds distances between two sets of trees" << endl;
+	} else
+		cout << "Computing Robinson-Foulds distance..." << endl;
+	int n = trees.size(), m = cols->size();
+
+	try {
+		ofstream out;
+		out.exceptions(ios::failbit | ios::badbit);
+		out.open(filename);
+		if (params.rf_dist_mode == RF_ADJACENT_PAIR) {
+			IntVector rfdist(n, 0);
+			for (int i = 0; i+1 < n; i++)
+				rfdist[i] = trees.computeRFDist(i, trees, i+1);
+			printRFDist(out, n > 0 ? &rfdist[0] : NULL, n, m, params.rf_dist_mode);
+			if (verbose_mode >= VB_MED)
+				printRFDist(cout, n > 0 ? &rfdist[0] : NULL, n, m, params.rf_dist_mode);
+		} else {
+			out << n << " " << m << endl;
+			if (verbose_mode >= VB_MED)
+				cout << n << " " << m << endl;
+			// about 16 MB of distances per block
+			int block_rows = max(1, min(n, (1 << 22) / max(m, 1)));
+			int *rfdist = new int[(size_t)block_rows * m];
+			for (int row = 0; row < n; row += block_rows) {
+				int row_end = min(n, row + block_rows);
+				trees.computeRFDist(row, row_end, *cols, rfdist);
+				printRFDistRows(out, rfdist, row, row_end, m);
+				if (verbose_mode >= VB_MED)
+					printRFDistRows(cout, rfdist, row, row_end, m);
+			}
+			delete [] rfdist;
+		}
+		out.close();
+		cout << "Robinson-Foulds distances printed to " << filename << endl;
+	} catch (ios::failure) {
+		outError(ERR_WRITE_OUTPUT, filename);
+	}
+}
+
 void computeRFDist(Params &params) {
 
 	if (!params.user_file) outError("User tree file not provided");
@@ -1447,6 +1513,12 @@ void computeRFDist(Params &params) {
 		return;
 	}
 
+	// the detailed split occurrences need the split bitsets of MTreeSet
+	if (params.rf_dist_mode != RF_TWO_TREE_SETS || verbose_mode < VB_MED) {
+		computeRFDistFingerprint(params, filename.c_str());
+		return;
+	}
+
 	MTreeSet trees(params.user_file, params.is_rooted, params.tree_burnin, params.tree_max_count);
 	int n = trees.size(), m = trees.size();
 	int *rfdist;
@@ -2283,6 +2355,14 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    checkpoint->setRecordTimeBudget(true);
+    // the -deadline budget covers the whole run, also the time used before it was interrupted
+    double budget_used = 0.0;
+    if (append_log && Params::getInstance().time_budget > 0 && checkpoint->get("timeBudgetUsed", budget_used)) {
+        Params::getInstance().time_budget_start -= budget_used;
+        Params::getInstance().analysis_budget_start -= budget_used;
+    }
+
     // after loading, workers are not allowed to write checkpoint anymore
     if (MPIHelper::getInstance().isWorker())
         checkpoint->setFileName("");
@@ -2295,6 +2375,8 @@ int main(int argc, char *argv[]) {
     if (append_log) {
         cout << endl << "******************************************************"
              << endl << "CHECKPOINT: Resuming analysis from " << filename << endl << endl;
+        if (budget_used > 0)
+            cout << "CHECKPOINT: " << budget_used << " seconds of the time budget already used" << endl << endl;
     }
 #ifdef _IQTREE_MPI
 	cout << "************************************************" << endl;
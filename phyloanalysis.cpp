@@ -45,6 +45,7 @@
 #include "stoprule.h"
 
 #include "mtreeset.h"
+#include "streamsplitset.h"
 #include "mexttree.h"
 #include "model/ratemeyerhaeseler.h"
 #include "whtest_wrapper.h"
@@ -1678,6 +1679,13 @@ void printFinalSearchInfo(Params &params, IQTree &iqtree, double search_cpu_time
 	params.run_time = (getCPUTime() - params.startCPUTime);
 	cout << endl;
 	cout << "Total number of iterations: " << iqtree.stop_rule.getCurIt() << endl;
+	if (verbose_mode >= VB_MED) {
+		uint64_t hits = 0, misses = 0;
+		iqtree.getPartialInfoCacheStats(hits, misses);
+		if (hits + misses > 0)
+			cout << "Tip partial likelihood cache: " << hits << " hits, " << misses << " misses ("
+				<< (100.0*hits)/(hits+misses) << "% hit rate)" << endl;
+	}
 //    cout << "Total number of partial likelihood vector computations: " << iqtree.num_partial_lh_computations << endl;
 	cout << "CPU time used for tree search: " << search_cpu_time
 			<< " sec (" << convert_time(search_cpu_time) << ")" << endl;
@@ -2379,11 +2387,29 @@ void runStandardBootstrap(Params &params, string &original_model, Alignment *ali
 
 		Alignment* bootstrap_alignment;
 		cout << "Creating bootstrap alignment (seed: " << params.ran_seed+sample << ")..." << endl;
-		if (alignment->isSuperAlignment())
+		if (alignment->isSuperAlignment()) {
 			bootstrap_alignment = new SuperAlignment;
-		else
+			bootstrap_alignment->createBootstrapAlignment(alignment, NULL, params.bootstrap_spec);
+		} else if (!alignment->site_state_freq.empty()) {
 			bootstrap_alignment = new Alignment;
-		bootstrap_alignment->createBootstrapAlignment(alignment, NULL, params.bootstrap_spec);
+			bootstrap_alignment->createBootstrapAlignment(alignment, NULL, params.bootstrap_spec);
+		} else {
+			// resample the pattern frequencies of the original alignment and keep only the
+			// patterns drawn at least once, instead of resampling and re-hashing every site
+			IntVector pattern_freq;
+			if (params.bootstrap_spec)
+				alignment->createBootstrapAlignment(pattern_freq, params.bootstrap_spec);
+			else {
+				// draw site by site as the per-site path does, not with the multinomial sampler
+				// of createBootstrapAlignment(), so that seeded runs give the same replicates
+				int nsite = alignment->getNSite();
+				pattern_freq.resize(alignment->getNPattern(), 0);
+				for (int site = 0; site < nsite; site++)
+					pattern_freq[alignment->getPatternID(random_int(nsite))]++;
+			}
+			bootstrap_alignment = new Alignment;
+			bootstrap_alignment->extractPatternFreqs(alignment, pattern_freq);
+		}
 
         // restore randstream
         finish_random();
@@ -2420,6 +2446,8 @@ void runStandardBootstrap(Params &params, string &original_model, Alignment *ali
         boot_tree->setCheckpoint(tree->getCheckpoint());
         boot_tree->num_precision = tree->num_precision;
 
+        // the replicates left and the analysis of the original alignment share the rest of the -deadline budget
+        startAnalysisBudget(params.num_bootstrap_samples - sample + (params.compute_ml_tree ? 1 : 0));
 		runTreeReconstruction(params, original_model, *boot_tree, *model_info);
 		// read in the output tree file
         stringstream ss;
@@ -2488,6 +2516,7 @@ void runStandardBootstrap(Params &params, string &original_model, Alignment *ali
         params.aLRT_test = saved_aLRT_test;
         params.aBayes_test = saved_aBayes_test;
         
+        startAnalysisBudget(1);
 		runTreeReconstruction(params, original_model, *tree, *model_info);
 
         if (MPIHelper::getInstance().isMaster()) {
@@ -2504,6 +2533,7 @@ void runStandardBootstrap(Params &params, string &original_model, Alignment *ali
 		STOP_CONDITION sc = params.stop_condition;
 		params.min_iterations = 0;
 		params.stop_condition = SC_FIXED_ITERATION;
+		startAnalysisBudget(1);
 		runTreeReconstruction(params, original_model, *tree, *model_info);
 		params.min_iterations = mi;
 		params.stop_condition = sc;
@@ -2805,6 +2835,8 @@ void runPhyloAnalysis(Params &params, Checkpoint *checkpoint) {
             tree->intermediateTrees.recomputeLoglOfAllTrees(*tree);
         }
 		reportPhyloAnalysis(params, original_model, *tree, *model_info);
+        if (params.eval_server)
+            serveTreeEvaluation(params, tree);
         }
 
 		// reinsert identical sequences
@@ -2816,6 +2848,8 @@ void runPhyloAnalysis(Params &params, Checkpoint *checkpoint) {
         delete model_info;
 	} else {
 		// the classical non-parameter bootstrap (SBS)
+		if (params.eval_server)
+			outError("-zserve is not allowed with standard bootstrap");
 		if (params.model_name.find("LINK") != string::npos || params.model_name.find("MERGE") != string::npos)
 			outError("-m TESTMERGE is not allowed when doing standard bootstrap. Please first\nfind partition scheme on the original alignment and use it for bootstrap analysis");
         if (alignment->getNSeq() < 4)
@@ -3003,7 +3037,6 @@ void computeConsensusTree(const char *input_trees, int burnin, int max_count,
 	if (params->scaling_factor > 0)
 		scale = params->scaling_factor;
 
-	MTreeSet boot_trees;
 	if (params && detectInputFile((char*) input_trees) == IN_NEXUS) {
 		char *user_file = params->user_file;
 		params->user_file = (char*) input_trees;
@@ -3022,10 +3055,11 @@ void computeConsensusTree(const char *input_trees, int burnin, int max_count,
 		 }*/
 		scale /= sg.maxWeight();
 	} else {
-		boot_trees.init(input_trees, rooted, burnin, max_count,
-				tree_weight_file);
-		boot_trees.convertSplits(sg, cutoff, SW_COUNT, weight_threshold);
-		scale /= boot_trees.sumTreeWeights();
+		// stream the trees, only the frequent splits are kept in memory
+		StreamSplitSet boot_splits;
+		boot_splits.convertSplits(input_trees, burnin, max_count, tree_weight_file,
+				sg, cutoff, weight_threshold);
+		scale /= boot_splits.sumTreeWeights();
 		cout << sg.size() << " splits found" << endl;
 	}
 	//sg.report(cout);
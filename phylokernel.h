@@ -67,6 +67,29 @@ Numeric PhyloTree::dotProductSIMD(Numeric *x, Numeric *y, int size) {
 	return horizontal_add(res);
 }
 
+template <class Numeric, class VectorClass>
+void PhyloTree::dotProductMultiSIMD(Numeric *x, Numeric *y, int size, int ny, size_t y_stride, Numeric *res) {
+	int j;
+	// four vectors of y at once: x is loaded once and the four sums are independent
+	for (j = 0; j+4 <= ny; j += 4) {
+		Numeric *y0 = y + j*y_stride, *y1 = y0 + y_stride, *y2 = y1 + y_stride, *y3 = y2 + y_stride;
+		VectorClass res0 = 0.0, res1 = 0.0, res2 = 0.0, res3 = 0.0;
+		for (int i = 0; i < size; i += VectorClass::size()) {
+			VectorClass xi = VectorClass().load_a(&x[i]);
+			res0 = mul_add(xi, VectorClass().load_a(&y0[i]), res0);
+			res1 = mul_add(xi, VectorClass().load_a(&y1[i]), res1);
+			res2 = mul_add(xi, VectorClass().load_a(&y2[i]), res2);
+			res3 = mul_add(xi, VectorClass().load_a(&y3[i]), res3);
+		}
+		res[j] = horizontal_add(res0);
+		res[j+1] = horizontal_add(res1);
+		res[j+2] = horizontal_add(res2);
+		res[j+3] = horizontal_add(res3);
+	}
+	for (; j < ny; j++)
+		res[j] = dotProductSIMD<Numeric, VectorClass>(x, y + j*y_stride, size);
+}
+
 /************************************************************************************************
  *
  *   Highly optimized vectorized versions of likelihood functions
@@ -1432,6 +1455,20 @@ inline UINT fast_popcount(Vec8ui &x) {
 
 }
 
+#if MAX_VECTOR_SIZE >= 512
+inline UINT fast_popcount(Vec16ui &x) {
+    MEM_ALIGN_BEGIN uint64_t vec[8] MEM_ALIGN_END;
+    x.store(vec);
+    UINT res = 0;
+    for (int i = 0; i < 8; i++)
+#if defined (__GNUC__) || defined(__clang__)
+        res += __builtin_popcountll(vec[i]);
+#else
+        res += _mm_popcnt_u64(vec[i]);
+#endif
+    return res;
+}
+#endif
 
 inline void horizontal_popcount(Vec4ui &x) {
     MEM_ALIGN_BEGIN UINT vec[4] MEM_ALIGN_END;
@@ -1608,7 +1645,7 @@ void PhyloTree::computePartialParsimonyFastSIMD(PhyloNeighbor *dad_branch, Phylo
         } // of end FOR LOOP
 
         assert(start_pos == aln->ordered_pattern.size());
-//        assert(site == aln->num_informative_sites % NUM_BITS);
+//        assert(site == aln->num_parsimony_sites % NUM_BITS);
         // add dummy states
         if (site > 0 && site < NUM_BITS) {
             x += site/UINT_BITS;
@@ -1632,7 +1669,8 @@ void PhyloTree::computePartialParsimonyFastSIMD(PhyloNeighbor *dad_branch, Phylo
         }
 //        VectorClass score = 0;
         UINT score = 0;
-        int nsites = (aln->num_informative_sites+NUM_BITS-1)/NUM_BITS;
+        int nsites = (aln->num_parsimony_sites+NUM_BITS-1)/NUM_BITS;
+        UINT *site_weight = aln->pars_site_weight.data();
         int entry_size = nstates * VCSIZE;
         
         switch (nstates) {
@@ -1657,7 +1695,7 @@ void PhyloTree::computePartialParsimonyFastSIMD(PhyloNeighbor *dad_branch, Phylo
                 z[3] |= w & (x[3] | y[3]);
 //				horizontal_popcount(w);
 //                score += w;
-                score += fast_popcount(w);
+                score += fast_popcount(w) * site_weight[site*VectorClass::size()];
 //                x += 4;
 //                y += 4;
 //                z += 4;
@@ -1685,7 +1723,7 @@ void PhyloTree::computePartialParsimonyFastSIMD(PhyloNeighbor *dad_branch, Phylo
 				}
 //				horizontal_popcount(w);
 //                score += w;
-                score += fast_popcount(w);
+                score += fast_popcount(w) * site_weight[site*VectorClass::size()];
                 x += nstates;
                 y += nstates;
                 z += nstates;
@@ -1718,7 +1756,8 @@ int PhyloTree::computeParsimonyBranchFastSIMD(PhyloNeighbor *dad_branch, PhyloNo
 //    VectorClass w;
 
     const int NUM_BITS = VectorClass::size() * UINT_BITS;
-    int nsites = (aln->num_informative_sites + NUM_BITS - 1)/NUM_BITS;
+    int nsites = (aln->num_parsimony_sites + NUM_BITS - 1)/NUM_BITS;
+    UINT *site_weight = aln->pars_site_weight.data();
     int entry_size = nstates * VectorClass::size();
     
     int scoreid = nsites*entry_size;
@@ -1740,7 +1779,7 @@ int PhyloTree::computeParsimonyBranchFastSIMD(PhyloNeighbor *dad_branch, PhyloNo
 			w = ~w;
 //			horizontal_popcount(w);
 //            score += w;
-            score += fast_popcount(w);
+            score += fast_popcount(w) * site_weight[site*VectorClass::size()];
             #ifndef _OPENMP
             if (score >= lower_bound) 
                 break;
@@ -1762,7 +1801,7 @@ int PhyloTree::computeParsimonyBranchFastSIMD(PhyloNeighbor *dad_branch, PhyloNo
 			w = ~w;
 //			horizontal_popcount(w);
 //            score += w;
-            score += fast_popcount(w);
+            score += fast_popcount(w) * site_weight[site*VectorClass::size()];
             #ifndef _OPENMP
             if (score >= lower_bound) 
                 break;
@@ -1783,5 +1822,62 @@ int PhyloTree::computeParsimonyBranchFastSIMD(PhyloNeighbor *dad_branch, PhyloNo
     return score;
 }
 
+template<class VectorClass>
+int PhyloTree::computeParsimonyInsertionFastSIMD(UINT *dad_pars, UINT *node_pars, UINT *taxon_pars) {
+    int site;
+    int nstates = aln->getMaxNumStates();
+    const int NUM_BITS = VectorClass::size() * UINT_BITS;
+    int nsites = (aln->num_parsimony_sites + NUM_BITS - 1)/NUM_BITS;
+    UINT *site_weight = aln->pars_site_weight.data();
+    int entry_size = nstates * VectorClass::size();
+
+    int scoreid = nsites*entry_size;
+    UINT score = dad_pars[scoreid] + node_pars[scoreid] + taxon_pars[scoreid];
+
+    // the new internal node is computed on the fly and never stored
+    switch (nstates) {
+    case 4:
+		for (site = 0; site < nsites; site++) {
+            size_t offset = entry_size*site;
+            VectorClass *x = (VectorClass*)(dad_pars + offset);
+            VectorClass *y = (VectorClass*)(node_pars + offset);
+            VectorClass *t = (VectorClass*)(taxon_pars + offset);
+            VectorClass z0 = x[0] & y[0];
+            VectorClass z1 = x[1] & y[1];
+            VectorClass z2 = x[2] & y[2];
+            VectorClass z3 = x[3] & y[3];
+            VectorClass w = ~(z0 | z1 | z2 | z3);
+            score += fast_popcount(w) * site_weight[site*VectorClass::size()];
+            z0 |= w & (x[0] | y[0]);
+            z1 |= w & (x[1] | y[1]);
+            z2 |= w & (x[2] | y[2]);
+            z3 |= w & (x[3] | y[3]);
+            w = ~((z0 & t[0]) | (z1 & t[1]) | (z2 & t[2]) | (z3 & t[3]));
+            score += fast_popcount(w) * site_weight[site*VectorClass::size()];
+		}
+		break;
+    default:
+		for (site = 0; site < nsites; site++) {
+            size_t offset = entry_size*site;
+            VectorClass *x = (VectorClass*)(dad_pars + offset);
+            VectorClass *y = (VectorClass*)(node_pars + offset);
+            VectorClass *t = (VectorClass*)(taxon_pars + offset);
+            int i;
+            VectorClass w = 0;
+            for (i = 0; i < nstates; i++)
+                w |= x[i] & y[i];
+            w = ~w;
+            score += fast_popcount(w) * site_weight[site*VectorClass::size()];
+            VectorClass wt = 0;
+            for (i = 0; i < nstates; i++)
+                wt |= ((x[i] & y[i]) | (w & (x[i] | y[i]))) & t[i];
+            wt = ~wt;
+            score += fast_popcount(wt) * site_weight[site*VectorClass::size()];
+		}
+		break;
+    }
+    return score;
+}
+
 
 #endif /* PHYLOKERNEL_H_ */
@@ -25,6 +25,12 @@
 #error "You must compile this file with AVX512 enabled!"
 #endif
 
+void PhyloTree::setParsimonyKernelAVX512() {
+	computeParsimonyBranchPointer = &PhyloTree::computeParsimonyBranchFastSIMD<Vec16ui>;
+    computePartialParsimonyPointer = &PhyloTree::computePartialParsimonyFastSIMD<Vec16ui>;
+    computeParsimonyInsertionPointer = &PhyloTree::computeParsimonyInsertionFastSIMD<Vec16ui>;
+}
+
 void PhyloTree::setDotProductAVX512() {
 #ifdef BOOT_VAL_FLOAT
 		dotProduct = &PhyloTree::dotProductSIMD<float, Vec16f>;
@@ -32,10 +38,11 @@ void PhyloTree::setDotProductAVX512() {
 		dotProduct = &PhyloTree::dotProductSIMD<double, Vec8d>;
 #endif
         dotProductDouble = &PhyloTree::dotProductSIMD<double, Vec8d>;
+        dotProductMultiDouble = &PhyloTree::dotProductMultiSIMD<double, Vec8d>;
 }
 
 void PhyloTree::setLikelihoodKernelAVX512() {
-//    setParsimonyKernelAVX();
+    setParsimonyKernelAVX512();
     if (model_factory && model_factory->model->isSiteSpecificModel()) {
         switch (aln->num_states) {
         case 4:
@@ -29,6 +29,7 @@ void PhyloTree::setDotProductFMA() {
 		dotProduct = &PhyloTree::dotProductSIMD<double, Vec4d>;
 #endif
         dotProductDouble = &PhyloTree::dotProductSIMD<double, Vec4d>;
+        dotProductMultiDouble = &PhyloTree::dotProductMultiSIMD<double, Vec4d>;
 }
 
 void PhyloTree::setLikelihoodKernelFMA() {
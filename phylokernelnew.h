@@ -750,6 +750,14 @@ void PhyloTree::computePartialInfo(TraversalInfo &info, VectorClass* buffer) {
         VectorClass *expchild = (VectorClass*)buffer;
         FOR_NEIGHBOR_IT(node, dad, it) {
             PhyloNeighbor *child = (PhyloNeighbor*)*it;
+            // tip partial likelihoods stay the same as long as the model and the branch length do;
+            // echild of a leaf is only needed to compute them
+            double *leaf_slot = child->node->isLeaf() ? partial_info_cache.getSlot(child->node->id) : NULL;
+            if (leaf_slot && partial_info_cache.isValid(child->node->id, child->length)) {
+                partial_lh_leaf += (aln->STATE_UNKNOWN+1)*block;
+                echild += block*nstates;
+                continue;
+            }
             VectorClass *echild_ptr = (VectorClass*)echild;
             // precompute information buffer
             for (c = 0; c < ncat_mix; c++) {
@@ -771,10 +779,11 @@ void PhyloTree::computePartialInfo(TraversalInfo &info, VectorClass* buffer) {
             // pre compute information for tip
             if (child->node->isLeaf()) {
                 vector<int>::iterator it;
+                double *leaf_lh = leaf_slot ? leaf_slot : partial_lh_leaf;
 
                 for (it = aln->seq_states[child->node->id].begin(); it != aln->seq_states[child->node->id].end(); it++) {
                     int state = (*it);
-                    double *this_partial_lh_leaf = partial_lh_leaf + state*block;
+                    double *this_partial_lh_leaf = leaf_lh + state*block;
                     VectorClass *echild_ptr = (VectorClass*)echild;
                     for (c = 0; c < ncat_mix; c++) {
                         VectorClass *this_tip_partial_lh = (VectorClass*)(tip_partial_lh + state*tip_block + mix_addr_nstates[c]);
@@ -791,8 +800,10 @@ void PhyloTree::computePartialInfo(TraversalInfo &info, VectorClass* buffer) {
                 }
                 size_t addr = aln->STATE_UNKNOWN * block;
                 for (x = 0; x < block; x++) {
-                    partial_lh_leaf[addr+x] = 1.0;
+                    leaf_lh[addr+x] = 1.0;
                 }
+                if (leaf_slot)
+                    partial_info_cache.setValid(child->node->id, child->length);
                 partial_lh_leaf += (aln->STATE_UNKNOWN+1)*block;
             }
             echild += block*nstates;
@@ -803,6 +814,12 @@ void PhyloTree::computePartialInfo(TraversalInfo &info, VectorClass* buffer) {
         double expchild[nstates];
         FOR_NEIGHBOR_IT(node, dad, it) {
             PhyloNeighbor *child = (PhyloNeighbor*)*it;
+            double *leaf_slot = child->node->isLeaf() ? partial_info_cache.getSlot(child->node->id) : NULL;
+            if (leaf_slot && partial_info_cache.isValid(child->node->id, child->length)) {
+                partial_lh_leaf += (aln->STATE_UNKNOWN+1)*block;
+                echild += block*nstates;
+                continue;
+            }
             // precompute information buffer
             double *echild_ptr = echild;
             for (c = 0; c < ncat_mix; c++) {
@@ -822,9 +839,10 @@ void PhyloTree::computePartialInfo(TraversalInfo &info, VectorClass* buffer) {
             // pre compute information for tip
             if (child->node->isLeaf()) {
                 vector<int>::iterator it;
+                double *leaf_lh = leaf_slot ? leaf_slot : partial_lh_leaf;
                 for (it = aln->seq_states[child->node->id].begin(); it != aln->seq_states[child->node->id].end(); it++) {
                     int state = (*it);
-                    double *this_partial_lh_leaf = partial_lh_leaf + state*block;
+                    double *this_partial_lh_leaf = leaf_lh + state*block;
                     double *echild_ptr = echild;
                     for (c = 0; c < ncat_mix; c++) {
                         double *this_tip_partial_lh = tip_partial_lh + state*tip_block + mix_addr_nstates[c];
@@ -841,8 +859,10 @@ void PhyloTree::computePartialInfo(TraversalInfo &info, VectorClass* buffer) {
                 }
                 size_t addr = aln->STATE_UNKNOWN * block;
                 for (x = 0; x < block; x++) {
-                    partial_lh_leaf[addr+x] = 1.0;
+                    leaf_lh[addr+x] = 1.0;
                 }
+                if (leaf_slot)
+                    partial_info_cache.setValid(child->node->id, child->length);
                 partial_lh_leaf += (aln->STATE_UNKNOWN+1)*block;
             }
             echild += block*nstates;
@@ -935,6 +955,8 @@ void PhyloTree::computeTraversalInfo(PhyloNode *node, PhyloNode *dad, bool compu
     if (!model->isSiteSpecificModel()) {
 
         int num_info = traversal_info.size();
+        size_t block = aln->num_states * ((model_factory->fused_mix_rate) ? site_rate->getNRate() : site_rate->getNRate()*model->getNMixtures());
+        partial_info_cache.init(leafNum, (aln->STATE_UNKNOWN+1)*block);
 
         if (verbose_mode >= VB_DEBUG) {
             cout << "traversal order:";
@@ -1206,15 +1228,15 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info, size_t
                         // external node
                         // load data for tip
                         for (i = 0; i < VectorClass::size(); i++) {
-                            double *child_lh;
+                            double *child_lh = partial_info_cache.getEntry(child->node->id, partial_lh_leaf);
                             if (ptn+i < orig_nptn)
-                                child_lh = partial_lh_leaf + block*(aln->at(ptn+i))[child->node->id];
+                                child_lh += block*(aln->at(ptn+i))[child->node->id];
                             else if (ptn+i < max_orig_nptn)
-                                child_lh = partial_lh_leaf + block*aln->STATE_UNKNOWN;
+                                child_lh += block*aln->STATE_UNKNOWN;
                             else if (ptn+i < nptn)
-                                child_lh = partial_lh_leaf + block*model_factory->unobserved_ptns[ptn+i-max_orig_nptn];
+                                child_lh += block*model_factory->unobserved_ptns[ptn+i-max_orig_nptn];
                             else
-                                child_lh = partial_lh_leaf + block*aln->STATE_UNKNOWN;
+                                child_lh += block*aln->STATE_UNKNOWN;
                             double *this_vec_tip = vec_tip+i;
                             for (c = 0; c < block; c++) {
                                 *this_vec_tip = child_lh[c];
@@ -1326,8 +1348,10 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info, size_t
 
         /*--------------------- TIP-TIP (cherry) case ------------------*/
 
-        double *partial_lh_left = SITE_MODEL ? &tip_partial_lh[left->node->id * tip_mem_size] : partial_lh_leaves;
-        double *partial_lh_right = SITE_MODEL ? &tip_partial_lh[right->node->id * tip_mem_size] : partial_lh_leaves + (aln->STATE_UNKNOWN+1)*block;
+        double *partial_lh_left = SITE_MODEL ? &tip_partial_lh[left->node->id * tip_mem_size] :
+            partial_info_cache.getEntry(left->node->id, partial_lh_leaves);
+        double *partial_lh_right = SITE_MODEL ? &tip_partial_lh[right->node->id * tip_mem_size] :
+            partial_info_cache.getEntry(right->node->id, partial_lh_leaves + (aln->STATE_UNKNOWN+1)*block);
 
 		// scale number must be ZERO
 	    memset(dad_branch->scale_num + (SAFE_NUMERIC ? ptn_lower*ncat_mix : ptn_lower), 0, scale_size * sizeof(UBYTE));
@@ -1433,7 +1457,8 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info, size_t
             right->scale_num + (SAFE_NUMERIC ? ptn_lower*ncat_mix : ptn_lower),
             scale_size * sizeof(UBYTE));
 
-        double *partial_lh_left = SITE_MODEL ? &tip_partial_lh[left->node->id * tip_mem_size] : partial_lh_leaves;
+        double *partial_lh_left = SITE_MODEL ? &tip_partial_lh[left->node->id * tip_mem_size] :
+            partial_info_cache.getEntry(left->node->id, partial_lh_leaves);
 
 
         double *vec_left = buffer_partial_lh_ptr + (2*block+nstates)*VectorClass::size()*thread_id;
@@ -26,6 +26,7 @@
 void PhyloTree::setParsimonyKernelSSE() {
 	computeParsimonyBranchPointer = &PhyloTree::computeParsimonyBranchFastSIMD<Vec4ui>;
     computePartialParsimonyPointer = &PhyloTree::computePartialParsimonyFastSIMD<Vec4ui>;
+    computeParsimonyInsertionPointer = &PhyloTree::computeParsimonyInsertionFastSIMD<Vec4ui>;
 }
 
 void PhyloTree::setDotProductSSE() {
@@ -35,6 +36,7 @@ void PhyloTree::setDotProductSSE() {
 		dotProduct = &PhyloTree::dotProductSIMD<double, Vec2d>;
 #endif
         dotProductDouble = &PhyloTree::dotProductSIMD<double, Vec2d>;
+        dotProductMultiDouble = &PhyloTree::dotProductMultiSIMD<double, Vec2d>;
 }
 
 void PhyloTree::setLikelihoodKernelSSE() {
@@ -44,6 +44,7 @@ public:
         lh_scale_factor = 0.0;
         partial_pars = NULL;
         size = 0;
+        topo_key = 0;
     }
 
     /**
@@ -59,6 +60,7 @@ public:
         lh_scale_factor = 0.0;
         partial_pars = NULL;
         size = 0;
+        topo_key = 0;
     }
 
     /**
@@ -137,6 +139,9 @@ private:
     /** size of subtree below this neighbor in terms of number of taxa */
     int size;
 
+    /** XOR of the random keys of all taxa below this neighbor, used for topology hashing */
+    uint64_t topo_key;
+
 };
 
 /**
@@ -881,6 +881,11 @@ void PhyloSuperTree::clearAllPartialLH(bool make_null) {
     }
 }
 
+void PhyloSuperTree::getPartialInfoCacheStats(uint64_t &hits, uint64_t &misses) {
+    for (iterator it = begin(); it != end(); it++)
+        (*it)->getPartialInfoCacheStats(hits, misses);
+}
+
 int PhyloSuperTree::computeParsimonyBranchObsolete(PhyloNeighbor *dad_branch, PhyloNode *dad, int *branch_subst) {
     int score = 0, part = 0;
     SuperNeighbor *dad_nei = (SuperNeighbor*)dad_branch;
@@ -202,6 +202,9 @@ public:
      NEWLY ADDED (2014-12-04): clear all partial likelihood for a clean computation again
      */
     virtual void clearAllPartialLH(bool make_null = false);
+
+    /** add the cache statistics of all partitions */
+    virtual void getPartialInfoCacheStats(uint64_t &hits, uint64_t &misses);
     
 
     /**
@@ -34,6 +34,7 @@
 #include "timeutil.h"
 
 #include "phyloanalysis.h"
+#include "bootweights.h"
 #include "gsl/mygsl.h"
 //#include "vectorclass/vectorclass.h"
 
@@ -973,6 +974,48 @@ void extractModelInfo(string set_name, vector<ModelInfo> &model_info, vector<Mod
 			break;
 }
 
+/**
+ * index the first position of the models of every subset in model_info, so that partition merging
+ * does not scan model_info, which grows by all candidate models for every subset tested
+ */
+static void indexModelInfo(vector<ModelInfo> &model_info, StringIntMap &info_index) {
+	info_index.clear();
+	for (int i = model_info.size()-1; i >= 0; i--)
+		info_index[model_info[i].set_name] = i;
+}
+
+/** extractModelInfo() using the index of indexModelInfo() */
+static void extractModelInfo(string set_name, vector<ModelInfo> &model_info, StringIntMap &info_index,
+    vector<ModelInfo> &part_model_info)
+{
+	StringIntMap::iterator it = info_index.find(set_name);
+	if (it == info_index.end())
+		return;
+	for (int i = it->second; i < model_info.size() && model_info[i].set_name == set_name; i++)
+		part_model_info.push_back(model_info[i]);
+}
+
+/** replaceModelInfo() keeping the index of indexModelInfo() up to date */
+static void replaceModelInfo(vector<ModelInfo> &model_info, StringIntMap &info_index, vector<ModelInfo> &new_info) {
+	string &set_name = new_info.front().set_name;
+	StringIntMap::iterator it = info_index.find(set_name);
+	if (it == info_index.end()) {
+		info_index[set_name] = model_info.size();
+		model_info.insert(model_info.end(), new_info.begin(), new_info.end());
+		return;
+	}
+	int first = it->second, last;
+	for (last = first; last < model_info.size() && model_info[last].set_name == set_name; last++)
+		;
+	if (new_info.size() == last - first) {
+		for (int i = first; i < last; i++)
+			model_info[i] = new_info[i - first];
+	} else {
+		replaceModelInfo(model_info, new_info);
+		indexModelInfo(model_info, info_index);
+	}
+}
+
 void mergePartitions(PhyloSuperTree* super_tree, vector<IntVector> &gene_sets, StrVector &model_names) {
 	cout << "Merging into " << gene_sets.size() << " partitions..." << endl;
 	vector<IntVector>::iterator it;
@@ -1214,13 +1257,22 @@ void testPartitionModel(Params &params, PhyloSuperTree* in_tree, vector<ModelInf
 	model_names.resize(in_tree->size());
 	StrVector greedy_model_trees;
 	greedy_model_trees.resize(in_tree->size());
+	// alignment and taxa of every subset, a merged pair is concatenated from the two subsets
+	// instead of from all their partitions
+	vector<Alignment*> subset_alns;
+	StrVector subset_taxa;
 	for (i = 0; i < gene_sets.size(); i++) {
 		gene_sets[i].push_back(i);
 		model_names[i] = in_tree->part_info[i].model_name;
 		greedy_model_trees[i] = in_tree->part_info[i].name;
+		subset_alns.push_back(super_aln->partitions[i]);
+		subset_taxa.push_back(super_aln->getPattern(i));
 	}
 	cout << "Merging models to increase model fit (about " << total_num_model << " total partition schemes)..." << endl;
-	int prev_part = -1;
+	// best model of every merged subset tested so far, keyed by its sorted gene IDs
+	map<IntVector, ModelInfo> subset_info;
+	StringIntMap info_index;
+	indexModelInfo(model_info, info_index);
 	while (gene_sets.size() >= 2) {
 		// stepwise merging charsets
 		double new_score = DBL_MAX;
@@ -1260,65 +1312,64 @@ void testPartitionModel(Params &params, PhyloSuperTree* in_tree, vector<ModelInf
         if (num_threads > 1 && num_pairs >= 1)
             quicksort(dist, 0, num_pairs-1, distID);
 
-#ifdef _OPENMP
-#pragma omp parallel for private(i) schedule(dynamic) if(!params.model_test_and_tree)
-#endif
+        // only subsets not tested in an earlier round are evaluated, the others are looked up
+        vector<IntVector> pair_sets(num_pairs), pair_keys(num_pairs);
+        IntVector new_pairs;
         for (int pair = 0; pair < num_pairs; pair++) {
             int part1 = distID[pair] >> 16;
             int part2 = distID[pair] & ((1<<16)-1);
             assert(part1 != part2);
-            IntVector merged_set;
+            IntVector &merged_set = pair_sets[pair];
             merged_set.insert(merged_set.end(), gene_sets[part1].begin(), gene_sets[part1].end());
             merged_set.insert(merged_set.end(), gene_sets[part2].begin(), gene_sets[part2].end());
+            pair_keys[pair] = merged_set;
+            sort(pair_keys[pair].begin(), pair_keys[pair].end());
+            if (subset_info.find(pair_keys[pair]) == subset_info.end())
+                new_pairs.push_back(pair);
+        }
+
+#ifdef _OPENMP
+#pragma omp parallel for private(i) schedule(dynamic) if(!params.model_test_and_tree)
+#endif
+        for (int j = 0; j < new_pairs.size(); j++) {
+            int pair = new_pairs[j];
+            int part1 = distID[pair] >> 16;
+            int part2 = distID[pair] & ((1<<16)-1);
+            IntVector &merged_set = pair_sets[pair];
             string set_name = "";
             for (i = 0; i < merged_set.size(); i++) {
                 if (i > 0)
                     set_name += "+";
                 set_name += in_tree->part_info[merged_set[i]].name;
             }
-            string model = "";
-            double logl = 0.0;
-            int df = 0;
-            double treelen = 0.0;
-            bool done_before = false;
-            if (prev_part >= 0 && part1 != prev_part && part2 != prev_part) {
-                // if pairs previously examined, reuse the information
-                for (vector<ModelInfo>::iterator mit = model_info.begin(); mit != model_info.end(); mit++)
-                    if (mit->set_name == set_name) {
-                        model = mit->name;
-                        logl = mit->logl;
-                        df = mit->df;
-                        treelen = mit->tree_len;
-                        done_before = true;
-                        break;
-                    }
-            }
             vector<ModelInfo> part_model_info;
             stringstream this_fmodel;
-            if (!done_before) {
-                Alignment *aln = super_aln->concatenateAlignments(merged_set);
-                PhyloTree *tree = in_tree->extractSubtree(merged_set);
-                tree->setAlignment(aln);
-                extractModelInfo(set_name, model_info, part_model_info);
-//                TODO
-                tree->num_precision = in_tree->num_precision;
-                if (params.model_test_and_tree) {
-                    tree->setCheckpoint(new Checkpoint());
-                }
-//#ifdef _OPENMP
-                model = testModel(params, tree, part_model_info, this_fmodel, models_block, 1, set_name);
-//#else
-//                model = testModel(params, tree, part_model_info, fmodel, set_name);
-//#endif
-                logl = part_model_info[0].logl;
-                df = part_model_info[0].df;
-                treelen = part_model_info[0].tree_len;
-                if (params.model_test_and_tree) {
-                    delete tree->getCheckpoint();
-                }
-                delete tree;
-                delete aln;
+            vector<Alignment*> pair_alns;
+            StrVector pair_taxa;
+            string union_taxa;
+            pair_alns.push_back(subset_alns[part1]);
+            pair_alns.push_back(subset_alns[part2]);
+            pair_taxa.push_back(subset_taxa[part1]);
+            pair_taxa.push_back(subset_taxa[part2]);
+            Alignment *aln = super_aln->concatenateAlignments(pair_alns, pair_taxa, union_taxa);
+            PhyloTree *tree = in_tree->extractSubtree(merged_set);
+            tree->setAlignment(aln);
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+            extractModelInfo(set_name, model_info, info_index, part_model_info);
+            tree->num_precision = in_tree->num_precision;
+            if (params.model_test_and_tree) {
+                tree->setCheckpoint(new Checkpoint());
             }
+            string model = testModel(params, tree, part_model_info, this_fmodel, models_block, 1, set_name);
+            double logl = part_model_info[0].logl;
+            int df = part_model_info[0].df;
+            if (params.model_test_and_tree) {
+                delete tree->getCheckpoint();
+            }
+            delete tree;
+            delete aln;
             double lhnew = lhsum - lhvec[part1] - lhvec[part2] + logl;
             int dfnew = dfsum - dfvec[part1] - dfvec[part2] + df;
             double score = computeInformationScore(lhnew, dfnew, ssize, params.model_test_criterion);
@@ -1326,38 +1377,44 @@ void testPartitionModel(Params &params, PhyloSuperTree* in_tree, vector<ModelInf
 #pragma omp critical
 #endif
 			{
-				if (!done_before) {
-//#ifdef _OPENMP
-                    fmodel << this_fmodel.str();
-//#endif
-					replaceModelInfo(model_info, part_model_info);
-                    num_model++;
-					cout.width(4);
-					cout << right << num_model << " ";
-					cout.width(12);
-					cout << left << model << " ";
-					cout.width(11);
-					cout << score << " " << set_name;
-                    if (num_model >= 10) {
-                        double remain_time = max(total_num_model-num_model, (int64_t)0)*(getRealTime()-start_time)/num_model;
-                        cout << "\t" << convert_time(getRealTime()-start_time) << " (" 
-                            << convert_time(remain_time) << " left)";
-                    }
-                    cout << endl;
-				}
-				if (score < new_score) {
-					new_score = score;
-					opt_part1 = part1;
-					opt_part2 = part2;
-					opt_lh = logl;
-					opt_df = df;
-                    opt_treelen = treelen;
-					opt_merged_set = merged_set;
-					opt_set_name = set_name;
-					opt_model_name = model;
-				}
+                fmodel << this_fmodel.str();
+                replaceModelInfo(model_info, info_index, part_model_info);
+                subset_info[pair_keys[pair]] = part_model_info[0];
+                num_model++;
+                cout.width(4);
+                cout << right << num_model << " ";
+                cout.width(12);
+                cout << left << model << " ";
+                cout.width(11);
+                cout << score << " " << set_name;
+                if (num_model >= 10) {
+                    double remain_time = max(total_num_model-num_model, (int64_t)0)*(getRealTime()-start_time)/num_model;
+                    cout << "\t" << convert_time(getRealTime()-start_time) << " (" 
+                        << convert_time(remain_time) << " left)";
+                }
+                cout << endl;
 			}
+        }
 
+        // find the best pair among the new and the previously tested subsets
+        for (int pair = 0; pair < num_pairs; pair++) {
+            int part1 = distID[pair] >> 16;
+            int part2 = distID[pair] & ((1<<16)-1);
+            ModelInfo &info = subset_info[pair_keys[pair]];
+            double lhnew = lhsum - lhvec[part1] - lhvec[part2] + info.logl;
+            int dfnew = dfsum - dfvec[part1] - dfvec[part2] + info.df;
+            double score = computeInformationScore(lhnew, dfnew, ssize, params.model_test_criterion);
+            if (score < new_score) {
+                new_score = score;
+                opt_part1 = part1;
+                opt_part2 = part2;
+                opt_lh = info.logl;
+                opt_df = info.df;
+                opt_treelen = info.tree_len;
+                opt_merged_set = pair_sets[pair];
+                opt_set_name = info.set_name;
+                opt_model_name = info.name;
+            }
         }
 		if (new_score >= inf_score) break;
 		inf_score = new_score;
@@ -1366,6 +1423,18 @@ void testPartitionModel(Params &params, PhyloSuperTree* in_tree, vector<ModelInf
 		dfsum = dfsum - dfvec[opt_part1] - dfvec[opt_part2] + opt_df;
 		cout << "Merging " << opt_set_name << " with " << criterionName(params.model_test_criterion) << " score: " << new_score << " (lh=" << lhsum << "  df=" << dfsum << ")" << endl;
 		// change entry opt_part1 to merged one
+		vector<Alignment*> pair_alns;
+		StrVector pair_taxa;
+		pair_alns.push_back(subset_alns[opt_part1]);
+		pair_alns.push_back(subset_alns[opt_part2]);
+		pair_taxa.push_back(subset_taxa[opt_part1]);
+		pair_taxa.push_back(subset_taxa[opt_part2]);
+		Alignment *merged_aln = super_aln->concatenateAlignments(pair_alns, pair_taxa, subset_taxa[opt_part1]);
+		if (gene_sets[opt_part1].size() > 1)
+			delete subset_alns[opt_part1];
+		if (gene_sets[opt_part2].size() > 1)
+			delete subset_alns[opt_part2];
+		subset_alns[opt_part1] = merged_aln;
 		gene_sets[opt_part1] = opt_merged_set;
 		lhvec[opt_part1] = opt_lh;
 		dfvec[opt_part1] = opt_df;
@@ -1373,16 +1442,20 @@ void testPartitionModel(Params &params, PhyloSuperTree* in_tree, vector<ModelInf
 		model_names[opt_part1] = opt_model_name;
 		greedy_model_trees[opt_part1] = "(" + greedy_model_trees[opt_part1] + "," + greedy_model_trees[opt_part2] + ")" +
 				convertIntToString(in_tree->size()-gene_sets.size()+1) + ":" + convertDoubleToString(inf_score);
-		prev_part = opt_part1;
 
 		// delete entry opt_part2
 		lhvec.erase(lhvec.begin() + opt_part2);
 		dfvec.erase(dfvec.begin() + opt_part2);
 		lenvec.erase(lenvec.begin() + opt_part2);
 		gene_sets.erase(gene_sets.begin() + opt_part2);
+		subset_alns.erase(subset_alns.begin() + opt_part2);
+		subset_taxa.erase(subset_taxa.begin() + opt_part2);
 		model_names.erase(model_names.begin() + opt_part2);
 		greedy_model_trees.erase(greedy_model_trees.begin() + opt_part2);
 	}
+	for (i = 0; i < gene_sets.size(); i++)
+		if (gene_sets[i].size() > 1)
+			delete subset_alns[i];
 
 	string final_model_tree;
 	if (greedy_model_trees.size() == 1)
@@ -1432,58 +1505,250 @@ bool isMixtureModel(ModelsBlock *models_block, string &model_str) {
     return false;
 }
 
-string testModel(Params &params, PhyloTree* in_tree, vector<ModelInfo> &model_info, ostream &fmodel, ModelsBlock *models_block,
-    int num_threads, string set_name, bool print_mem_usage)
-{
-	SeqType seq_type = in_tree->aln->seq_type;
-	if (in_tree->isSuperTree())
-		seq_type = ((PhyloSuperTree*)in_tree)->front()->aln->seq_type;
-	if (seq_type == SEQ_UNKNOWN)
-		outError("Unknown data for model testing.");
-	string fmodel_str = params.out_prefix;
-	fmodel_str += ".model";
-	string sitelh_file = params.out_prefix;
-	sitelh_file += ".sitelh";
-	in_tree->params = &params;
-	StrVector model_names;
-	int max_cats = getModelList(params, in_tree->aln, model_names, params.model_test_separate_rate);
-	int model;
+/** patterns of a DNA alignment per likelihood kernel thread, below which model testing runs several models at once */
+#define MODEL_TEST_PATTERNS_PER_THREAD 2000
 
-    if (print_mem_usage) {
-        uint64_t mem_size = in_tree->getMemoryRequired(max_cats);
-        cout << "NOTE: MODEL SELECTION REQUIRES " << (mem_size / 1024) / 1024
-                << " MB MEMORY!" << endl;
-        if (mem_size >= getMemorySize()) {
-            outError("Memory required exceeds your computer RAM size!");
-        }
-#ifdef BINARY32
-        if (mem_size >= 2000000000) {
-            outError("Memory required exceeds 2GB limit of 32-bit executable");
+/** @return substitution part of a model name, i.e. the name without rate heterogeneity */
+static string getSubstModelName(string &model_name) {
+    size_t pos = model_name.length();
+    pos = min(pos, model_name.find("+I"));
+    pos = min(pos, model_name.find("+G"));
+    pos = min(pos, model_name.find("+R"));
+    return model_name.substr(0, pos);
+}
+
+/**
+ * split the candidate models into groups that can be evaluated concurrently, each on its own copy of the tree.
+ * Models of one group share the substitution model and are evaluated in order, because +R models start
+ * from the parameters of the previous one and the remaining +R models are skipped once the score gets worse.
+ * @param max_cats maximum number of rate categories of the candidate models
+ * @param model_groups (OUT) groups of model indices, in the order of the candidate models
+ * @param group_order (OUT) order in which the groups are started, most expensive first
+ * @param kernel_threads (OUT) number of likelihood kernel threads per group
+ * @return number of groups evaluated at the same time, 1 to evaluate all models one after another (always without -mgroup)
+ */
+static int groupModels(Params &params, PhyloTree *tree, StrVector &model_names, ModelsBlock *models_block,
+    int num_threads, int max_cats, vector<IntVector> &model_groups, IntVector &group_order, int &kernel_threads)
+{
+    kernel_threads = num_threads;
+    model_groups.clear();
+    group_order.clear();
+#ifdef _OPENMP
+    if (!params.model_test_concurrent || num_threads <= 1 || params.model_test_and_tree || params.model_test_separate_rate || params.print_site_lh)
+        return 1;
+    DoubleVector costs;
+    string prev_name = "";
+    for (int model = 0; model < model_names.size(); model++) {
+        string &name = model_names[model];
+        // +ASC rebuilds the states of the alignment, which all tree copies share
+        if (name.find("+ASC") != string::npos)
+            return 1;
+        bool mixture = isMixtureModel(models_block, name);
+        string subst_name = mixture ? "" : getSubstModelName(name);
+        if (mixture || model_groups.empty() || prev_name == "" || subst_name != prev_name) {
+            model_groups.push_back(IntVector());
+            costs.push_back(0.0);
         }
+        prev_name = subst_name;
+        model_groups.back().push_back(model);
+        // cost of a model grows with the number of rate categories, mixture models go first
+        size_t pos;
+        double ncat = 1.0;
+        if ((pos = name.find("+G")) != string::npos || (pos = name.find("+R")) != string::npos)
+            ncat = (name.length() > pos+2 && isdigit(name[pos+2])) ? convert_int(name.c_str() + pos+2) : params.num_rate_cats;
+        if (name.find("+I") != string::npos)
+            ncat += 1.0;
+        costs.back() += mixture ? max_cats * 1000.0 : ncat;
+    }
+
+    // large alignments keep more threads in the likelihood kernel
+    double nptn = (double)tree->aln->getNPattern() * tree->aln->num_states / 4;
+    kernel_threads = max(1, min(num_threads, (int)(nptn / MODEL_TEST_PATTERNS_PER_THREAD)));
+    int num_groups = min(num_threads / kernel_threads, (int)model_groups.size());
+    uint64_t mem_size = tree->getMemoryRequired(max_cats);
+    if (mem_size > 0)
+        num_groups = min((int64_t)num_groups, max((int64_t)1, (int64_t)(getMemorySize() / 2 / mem_size)));
+    if (num_groups <= 1) {
+        kernel_threads = num_threads;
+        return 1;
+    }
+
+    // most expensive groups first, so that they do not finish last
+    group_order.resize(model_groups.size());
+    for (int group = 0; group < model_groups.size(); group++) {
+        group_order[group] = group;
+        costs[group] = -costs[group];
+    }
+    quicksort(&costs[0], 0, model_groups.size()-1, &group_order[0]);
+    return num_groups;
+#else
+    return 1;
 #endif
+}
+
+/**
+ * split the rate heterogeneity of a candidate model into +I and +G
+ * @param invar (OUT) TRUE if the model has +I
+ * @param gamma_cats (OUT) number of +G categories, 0 without +G
+ * @return FALSE if the model has other rate heterogeneity, e.g. +R or +ASC
+ */
+static bool getInvarGammaRate(Params &params, string &model_name, bool &invar, int &gamma_cats) {
+    string rate = model_name.substr(getSubstModelName(model_name).length());
+    size_t pos = 0;
+    invar = false;
+    gamma_cats = 0;
+    if (rate.compare(pos, 2, "+I") == 0) {
+        invar = true;
+        pos += 2;
+    }
+    if (rate.compare(pos, 2, "+G") == 0) {
+        pos += 2;
+        gamma_cats = params.num_rate_cats;
+        if (pos < rate.length() && isdigit(rate[pos]))
+            gamma_cats = convert_int(rate.c_str() + pos);
+        while (pos < rate.length() && isdigit(rate[pos]))
+            pos++;
     }
+    return pos == rate.length();
+}
 
-	string best_model = "";
-	/* first check the model file */
+/**
+ * @return TRUE if sub_name is a special case of super_name, so that the maximum log-likelihood
+ * of super_name bounds that of sub_name: both share the substitution model and the rate
+ * heterogeneity of sub_name is a subset of +I+G of super_name
+ */
+static bool isNestedModel(Params &params, ModelsBlock *models_block, string &sub_name, string &super_name) {
+    if (sub_name == super_name || isMixtureModel(models_block, sub_name) || isMixtureModel(models_block, super_name))
+        return false;
+    if (getSubstModelName(sub_name) != getSubstModelName(super_name))
+        return false;
+    bool sub_invar, super_invar;
+    int sub_gamma, super_gamma;
+    if (!getInvarGammaRate(params, sub_name, sub_invar, sub_gamma) ||
+        !getInvarGammaRate(params, super_name, super_invar, super_gamma))
+        return false;
+    if (sub_invar && !super_invar)
+        return false;
+    if (sub_gamma && sub_gamma != super_gamma)
+        return false;
+    return sub_invar != super_invar || sub_gamma != super_gamma;
+}
 
-	if (in_tree->isSuperTree()) {
-		// select model for each partition
-		PhyloSuperTree *stree = (PhyloSuperTree*)in_tree;
-		testPartitionModel(params, stree, model_info, fmodel, models_block, num_threads);
-//        stree->linkTrees();
-        stree->mapTrees();
-		string res_models = "";
-		for (vector<PartitionInfo>::iterator it = stree->part_info.begin(); it != stree->part_info.end(); it++) {
-			if (it != stree->part_info.begin()) res_models += ",";
-			res_models += (*it).model_name;
-		}
-		return res_models;
-	}
+/**
+ * move the models that nest other models to the front of their run of models with the same
+ * substitution model, so that the nested models can be pruned (-mprune)
+ * @param model_ids (IN/OUT) indices of the models in the order of evaluation
+ */
+static void orderModelsForPruning(Params &params, StrVector &model_names, ModelsBlock *models_block, IntVector &model_ids) {
+    IntVector ordered;
+    int start, end, i, j;
+    for (start = 0; start < model_ids.size(); start = end) {
+        string subst_name = getSubstModelName(model_names[model_ids[start]]);
+        for (end = start+1; end < model_ids.size() && getSubstModelName(model_names[model_ids[end]]) == subst_name; end++)
+            ;
+        BoolVector first(end-start, false);
+        for (i = start; i < end; i++) {
+            bool nests = false, nested = false;
+            for (j = start; j < end; j++) {
+                if (isNestedModel(params, models_block, model_names[model_ids[j]], model_names[model_ids[i]]))
+                    nests = true;
+                if (isNestedModel(params, models_block, model_names[model_ids[i]], model_names[model_ids[j]]))
+                    nested = true;
+            }
+            first[i-start] = nests && !nested;
+        }
+        for (i = start; i < end; i++)
+            if (first[i-start])
+                ordered.push_back(model_ids[i]);
+        for (i = start; i < end; i++)
+            if (!first[i-start])
+                ordered.push_back(model_ids[i]);
+    }
+    model_ids = ordered;
+}
 
-	in_tree->optimize_by_newton = params.optimize_by_newton;
-	in_tree->setLikelihoodKernel(params.SSE, num_threads);
+/**
+ * optimized parameters of an evaluated model, the starting point of its neighbouring models.
+ * Rate heterogeneity is not kept: every rate model has its own rate object that keeps its parameters
+ * from the previous substitution model, which was a better start than the nested rate model.
+ */
+struct ModelWarmStart {
+    DoubleVector brlens; // branch lengths
+    DoubleVector rates;  // substitution rates
+    DoubleVector freqs;  // state frequencies
+};
 
-//    int num_rate_classes = 3 + params.max_rate_cats;
+/**
+ * find the closest evaluated neighbour of a model in the model dependency graph: +R(k) starts from
+ * +R(k-1), a model nesting others starts from the nested model with the most parameters (+I+G from +G
+ * before +I), otherwise from the last model with the same substitution model
+ * @param evaluated models evaluated so far, in the order of evaluation
+ * @return index of the neighbour, -1 if none
+ */
+static int findWarmStartModel(Params &params, ModelsBlock *models_block, StrVector &model_names, int model,
+    IntVector &evaluated)
+{
+    string &name = model_names[model];
+    if (isMixtureModel(models_block, name))
+        return -1;
+    string subst_name = getSubstModelName(name);
+    string rate = name.substr(subst_name.length());
+    int i;
+    size_t pos = rate.find("+R");
+    if (pos != string::npos) {
+        int ncat = params.num_rate_cats;
+        if (rate.length() > pos+2 && isdigit(rate[pos+2]))
+            ncat = convert_int(rate.c_str() + pos+2);
+        string prev_name = subst_name + rate.substr(0, pos+2) + convertIntToString(ncat-1);
+        for (i = evaluated.size()-1; i >= 0; i--)
+            if (model_names[evaluated[i]] == prev_name)
+                return evaluated[i];
+    }
+    int warm_model = -1, warm_score = -1;
+    for (i = evaluated.size()-1; i >= 0; i--) {
+        string &prev_name = model_names[evaluated[i]];
+        bool invar;
+        int gamma_cats;
+        if (isNestedModel(params, models_block, prev_name, name) && getInvarGammaRate(params, prev_name, invar, gamma_cats)) {
+            int score = (gamma_cats ? 2 : 0) + (invar ? 1 : 0);
+            if (score > warm_score) {
+                warm_model = evaluated[i];
+                warm_score = score;
+            }
+        }
+    }
+    if (warm_model >= 0)
+        return warm_model;
+    for (i = evaluated.size()-1; i >= 0; i--)
+        if (!isMixtureModel(models_block, model_names[evaluated[i]]) && getSubstModelName(model_names[evaluated[i]]) == subst_name)
+            return evaluated[i];
+    return -1;
+}
+
+/**
+ * evaluate a list of candidate models one after another on one tree
+ * @param in_tree tree to evaluate the models on
+ * @param model_names names of all candidate models
+ * @param model_ids indices of the models to evaluate, in the order of evaluation
+ * @param model_info (IN/OUT) all model information
+ * @param info_ids (OUT) index in model_info of every evaluated model
+ * @param num_threads number of threads for the likelihood kernel
+ * @param ssize sample size for the information criteria
+ * @param concurrent TRUE if other model lists are evaluated at the same time on copies of the tree
+ * @param best_scores (IN/OUT) best AIC, AICc and BIC so far of this model list, used for pruning
+ * @param model_aic, model_aicc, model_bic (OUT) index in model_info of the best model
+ * @param table_rows (OUT) if not NULL, the table row of every model is stored here instead of printed
+ */
+static void evaluateModelList(Params &params, PhyloTree *in_tree, StrVector &model_names, IntVector &model_ids,
+    vector<ModelInfo> &model_info, IntVector &info_ids, ostream &fmodel, ModelsBlock *models_block,
+    int num_threads, string set_name, int ssize, bool concurrent, DoubleVector &best_scores,
+    int &model_aic, int &model_aicc, int &model_bic, StrVector *table_rows = NULL)
+{
+	SeqType seq_type = in_tree->aln->seq_type;
+	string fmodel_str = params.out_prefix;
+	fmodel_str += ".model";
+	string best_model = "";
+	int model;
 
 	RateHeterogeneity ** rate_class = new RateHeterogeneity*[4];
 	rate_class[0] = new RateHeterogeneity();
@@ -1520,39 +1785,24 @@ string testModel(Params &params, PhyloTree* in_tree, vector<ModelInfo> &model_in
 	ModelFactory *model_fac = new ModelFactory();
 	model_fac->joint_optimize = params.optimize_model_rate_joint;
 
-	int ssize = in_tree->aln->getNSite(); // sample size
-	if (params.model_test_sample_size)
-		ssize = params.model_test_sample_size;
-	if (set_name == "") {
-		cout << "Testing " << model_names.size() << " "
-			<< ((seq_type == SEQ_BINARY) ? "binary" : ((seq_type == SEQ_DNA) ? "DNA" :
-				((seq_type == SEQ_PROTEIN) ? "protein": ((seq_type == SEQ_CODON) ? "codon": "morphological"))))
-			<< " models (sample size: " << ssize << ") ..." << endl;
-        if (params.model_test_and_tree == 0)
-            cout << " No. Model         -LnL         df  AIC          AICc         BIC" << endl;
-	}
-	if (params.print_site_lh) {
-		ofstream sitelh_out(sitelh_file.c_str());
-		if (!sitelh_out.is_open())
-			outError("Cannot write to file ", sitelh_file);
-		sitelh_out << model_names.size() << " " << in_tree->getAlnNSite() << endl;
-		sitelh_out.close();
-	}
-	vector<ModelInfo>::iterator it;
-	for (it = model_info.begin(); it != model_info.end(); it++) {
-		it->AIC_score = DBL_MAX;
-		it->AICc_score = DBL_MAX;
-		it->BIC_score = DBL_MAX;
-	}
-
 	uint64_t RAM_requirement = 0;
-    int model_aic = -1, model_aicc = -1, model_bic = -1;
     string prev_tree_string = "";
     int prev_model_id = -1;
     int skip_model = 0;
+    bool prune = params.model_test_prune && !params.model_test_and_tree && !params.model_test_separate_rate;
+    vector<ModelWarmStart> warm_start(model_names.size());
+    IntVector evaluated;
+    model_aic = model_aicc = model_bic = -1;
 
-	for (model = 0; model < model_names.size(); model++) {
+	for (int k = 0; k < model_ids.size(); k++) {
+		model = model_ids[k];
 		//cout << model_names[model] << endl;
+        if (model_bic >= 0 && getRemainingTimeBudget(BUDGET_MODEL_SELECTION) <= 0) {
+            if (set_name == "")
+                cout << "NOTE: Time budget for model selection used up, " << model_ids.size() - k
+                     << " models not tested" << endl;
+            break;
+        }
         if (model_names[model][0] == '+') {
             // now switching to test rate heterogeneity
             if (best_model == "")
@@ -1574,23 +1824,30 @@ string testModel(Params &params, PhyloTree* in_tree, vector<ModelInfo> &model_in
         ModelFactory *this_model_fac = NULL;
         bool mixture_model = false;
         int ncat = 0;
-        string orig_name = params.model_name;
-        
+
         if (isMixtureModel(models_block, model_names[model])) {
             // mixture model
-            try {
-                mixture_model = true;
+            mixture_model = true;
+            // ModelFactory reads the model name from params, which concurrent model groups share
+#ifdef _OPENMP
+#pragma omp critical(model_test_params)
+#endif
+            {
+                string orig_name = params.model_name;
                 params.model_name = model_names[model];
-                this_model_fac = new ModelFactory(params, tree, models_block);
-                tree->setModelFactory(this_model_fac);
-                tree->setModel(this_model_fac->model);
-                tree->setRate(this_model_fac->site_rate);
-                tree->deleteAllPartialLh();
-                tree->initializeAllPartialLh();
-                RAM_requirement = max(RAM_requirement, tree->getMemoryRequired());
-            } catch (string &str) {
-                outError("Invalid -madd model " + model_names[model] + ": " + str);
+                try {
+                    this_model_fac = new ModelFactory(params, tree, models_block);
+                } catch (string &str) {
+                    outError("Invalid -madd model " + model_names[model] + ": " + str);
+                }
+                params.model_name = orig_name;
             }
+            tree->setModelFactory(this_model_fac);
+            tree->setModel(this_model_fac->model);
+            tree->setRate(this_model_fac->site_rate);
+            tree->deleteAllPartialLh();
+            tree->initializeAllPartialLh();
+            RAM_requirement = max(RAM_requirement, tree->getMemoryRequired());
         } else {
             // kernel might be changed if mixture model was tested
             in_tree->setLikelihoodKernel(params.SSE, num_threads);
@@ -1608,7 +1865,9 @@ string testModel(Params &params, PhyloTree* in_tree, vector<ModelInfo> &model_in
                 tree->aln->buildSeqStates(true);
             } else {
                 model_fac->unobserved_ptns = "";
-                tree->aln->buildSeqStates(false);
+                // concurrent model groups share the alignment, its states were built beforehand
+                if (!concurrent)
+                    tree->aln->buildSeqStates(false);
             }
             // initialize tree
             // initialize model
@@ -1715,11 +1974,35 @@ string testModel(Params &params, PhyloTree* in_tree, vector<ModelInfo> &model_in
 					outError("Inconsistent model file " + fmodel_str + ", please rerun using -mredo option");
 				break;
 			}
+        // the log-likelihood of a model is at most that of an evaluated model nesting it
+        bool prune_model = false;
+        double logl_bound = 0.0;
+        if (prune && model_id < 0 && !skip_model && !mixture_model) {
+            bool bounded = false;
+            for (int j = 0; j < k; j++) {
+                int info_id = info_ids[model_ids[j]];
+                if (info_id < 0 || !isNestedModel(params, models_block, model_names[model], model_names[model_ids[j]]))
+                    continue;
+                if (!bounded || model_info[info_id].logl < logl_bound)
+                    logl_bound = model_info[info_id].logl;
+                bounded = true;
+            }
+            if (bounded) {
+                double aic, aicc, bic;
+                computeInformationScores(logl_bound, info.df, ssize, aic, aicc, bic);
+                prune_model = aic > best_scores[0] && aicc > best_scores[1] && bic > best_scores[2];
+            }
+        }
 		if (model_id >= 0) {
 			info.logl = model_info[model_id].logl;
             info.tree_len = model_info[model_id].tree_len;
             info.tree = model_info[model_id].tree;
             prev_tree_string = model_info[model_id].tree;
+        } else if (prune_model) {
+            if (verbose_mode >= VB_MED)
+                cout << "Pruning model " << info.name << " with log-likelihood at most " << logl_bound << endl;
+            info.logl = logl_bound;
+            info.tree_len = 0.0;
         } else if (skip_model) {
             assert(prev_model_id >= 0);
             if (prev_model_id >= 0) {
@@ -1786,6 +2069,19 @@ string testModel(Params &params, PhyloTree* in_tree, vector<ModelInfo> &model_in
                     tree->fixNegativeBranch(true);
                     tree->clearAllPartialLH();
                 }
+                // start from the optimized parameters of the closest evaluated model
+                int warm_model = mixture_model ? -1 : findWarmStartModel(params, models_block, model_names, model, evaluated);
+                if (warm_model >= 0) {
+                    ModelWarmStart &warm = warm_start[warm_model];
+                    if (verbose_mode >= VB_MED)
+                        cout << "Starting from parameters of " << model_names[warm_model] << endl;
+                    tree->restoreBranchLengths(warm.brlens);
+                    subst_model->setRateMatrix(&warm.rates[0]);
+                    if (subst_model->freq_type == FREQ_ESTIMATE)
+                        subst_model->setStateFrequency(&warm.freqs[0]);
+                    subst_model->decomposeRateMatrix();
+                    tree->clearAllPartialLH();
+                }
                 if (verbose_mode >= VB_MED)
                     cout << "Optimizing model " << info.name << endl;
                 info.logl = tree->getModelFactory()->optimizeParameters(false, false, TOL_LIKELIHOOD_MODELTEST, TOL_GRADIENT_MODELTEST);
@@ -1809,6 +2105,15 @@ string testModel(Params &params, PhyloTree* in_tree, vector<ModelInfo> &model_in
                         info.tree_len = tree->treeLength();                        
                     }
                 }
+                if (!mixture_model) {
+                    ModelWarmStart &warm = warm_start[model];
+                    tree->saveBranchLengths(warm.brlens);
+                    warm.rates.resize(subst_model->getNumRateEntries());
+                    subst_model->getRateMatrix(&warm.rates[0]);
+                    warm.freqs.resize(subst_model->num_states);
+                    subst_model->getStateFrequency(&warm.freqs[0]);
+                    evaluated.push_back(model);
+                }
 //                info.tree = tree->getTreeString();
             }
 			// print information to .model file
@@ -1853,6 +2158,16 @@ string testModel(Params &params, PhyloTree* in_tree, vector<ModelInfo> &model_in
         }
         if (skip_model > 1)
             info.AIC_score = DBL_MAX;
+        if (prune_model) {
+            // only a bound, keep it out of the model ranking
+            info.AIC_score = DBL_MAX;
+            info.AICc_score = DBL_MAX;
+            info.BIC_score = DBL_MAX;
+        } else {
+            best_scores[0] = min(best_scores[0], info.AIC_score);
+            best_scores[1] = min(best_scores[1], info.AICc_score);
+            best_scores[2] = min(best_scores[2], info.BIC_score);
+        }
         
 		if (model_id >= 0) {
 			model_info[model_id] = info;
@@ -1860,6 +2175,7 @@ string testModel(Params &params, PhyloTree* in_tree, vector<ModelInfo> &model_in
 			model_info.push_back(info);
             model_id = model_info.size()-1;
 		}
+        info_ids[model] = model_id;
 		if (model_aic < 0 || model_info[model_id].AIC_score < model_info[model_aic].AIC_score)
 			model_aic = model_id;
 		if (model_aicc < 0 || model_info[model_id].AICc_score < model_info[model_aicc].AICc_score)
@@ -1872,7 +2188,6 @@ string testModel(Params &params, PhyloTree* in_tree, vector<ModelInfo> &model_in
             delete this_model_fac->site_rate;
             delete this_model_fac;
             this_model_fac = NULL;
-            params.model_name = orig_name;
         }
         
         in_tree->setModel(NULL);
@@ -1883,31 +2198,236 @@ string testModel(Params &params, PhyloTree* in_tree, vector<ModelInfo> &model_in
 
 		if (set_name != "") continue;
 
-		cout.width(3);
-		cout << right << model+1 << "  ";
-		cout.width(13);
-		cout << left << info.name << " ";
+		ostringstream row;
+		ostream &out = table_rows ? (ostream&)row : cout;
+		out.width(3);
+		out << right << model+1 << "  ";
+		out.width(13);
+		out << left << info.name << " ";
         
         if (skip_model > 1) {
-            cout << "Skipped " << endl;
-            continue;
+            out << "Skipped " << endl;
+        } else if (prune_model) {
+            out << "Pruned " << endl;
+        } else {
+		out.precision(3);
+		out << fixed;
+		out.width(12);
+		out << -info.logl << " ";
+		out.width(3);
+		out << info.df << " ";
+		out.width(12);
+		out << info.AIC_score << " ";
+		out.width(12);
+		out << info.AICc_score << " " << info.BIC_score;
+		out << endl;
         }
-        
-		cout.precision(3);
-		cout << fixed;
-		cout.width(12);
-		cout << -info.logl << " ";
-		cout.width(3);
-		cout << info.df << " ";
-		cout.width(12);
-		cout << info.AIC_score << " ";
-		cout.width(12);
-		cout << info.AICc_score << " " << info.BIC_score;
-		cout << endl;
+        if (table_rows)
+            (*table_rows)[model] = row.str();
+	}
 
+	delete model_fac;
+	delete subst_model;
+    int rate_type;
+	for (rate_type = 3; rate_type >= 0; rate_type--) {
+		delete rate_class[rate_type];
+    }
+    delete [] rate_class;
+    
+	for (rate_type = params.max_rate_cats-2; rate_type >= 0; rate_type--) {
+		delete rate_class_free[rate_type];
+    }
+    delete [] rate_class_free;
+
+	for (rate_type = params.max_rate_cats-2; rate_type >= 0; rate_type--) {
+		delete rate_class_freeinvar[rate_type];
+    }
+    delete [] rate_class_freeinvar;
+}
 
+string testModel(Params &params, PhyloTree* in_tree, vector<ModelInfo> &model_info, ostream &fmodel, ModelsBlock *models_block,
+    int num_threads, string set_name, bool print_mem_usage)
+{
+	SeqType seq_type = in_tree->aln->seq_type;
+	if (in_tree->isSuperTree())
+		seq_type = ((PhyloSuperTree*)in_tree)->front()->aln->seq_type;
+	if (seq_type == SEQ_UNKNOWN)
+		outError("Unknown data for model testing.");
+	string fmodel_str = params.out_prefix;
+	fmodel_str += ".model";
+	string sitelh_file = params.out_prefix;
+	sitelh_file += ".sitelh";
+	in_tree->params = &params;
+	StrVector model_names;
+	int max_cats = getModelList(params, in_tree->aln, model_names, params.model_test_separate_rate);
+	int model;
+
+    if (print_mem_usage) {
+        uint64_t mem_size = in_tree->getMemoryRequired(max_cats);
+        cout << "NOTE: MODEL SELECTION REQUIRES " << (mem_size / 1024) / 1024
+                << " MB MEMORY!" << endl;
+        if (mem_size >= getMemorySize()) {
+            outError("Memory required exceeds your computer RAM size!");
+        }
+#ifdef BINARY32
+        if (mem_size >= 2000000000) {
+            outError("Memory required exceeds 2GB limit of 32-bit executable");
+        }
+#endif
+    }
+
+	string best_model = "";
+	/* first check the model file */
+
+	if (in_tree->isSuperTree()) {
+		// select model for each partition
+		PhyloSuperTree *stree = (PhyloSuperTree*)in_tree;
+		testPartitionModel(params, stree, model_info, fmodel, models_block, num_threads);
+//        stree->linkTrees();
+        stree->mapTrees();
+		string res_models = "";
+		for (vector<PartitionInfo>::iterator it = stree->part_info.begin(); it != stree->part_info.end(); it++) {
+			if (it != stree->part_info.begin()) res_models += ",";
+			res_models += (*it).model_name;
+		}
+		return res_models;
+	}
+
+	in_tree->optimize_by_newton = params.optimize_by_newton;
+	in_tree->setLikelihoodKernel(params.SSE, num_threads);
+
+//    int num_rate_classes = 3 + params.max_rate_cats;
+
+
+	int ssize = in_tree->aln->getNSite(); // sample size
+	if (params.model_test_sample_size)
+		ssize = params.model_test_sample_size;
+	if (set_name == "") {
+		cout << "Testing " << model_names.size() << " "
+			<< ((seq_type == SEQ_BINARY) ? "binary" : ((seq_type == SEQ_DNA) ? "DNA" :
+				((seq_type == SEQ_PROTEIN) ? "protein": ((seq_type == SEQ_CODON) ? "codon": "morphological"))))
+			<< " models (sample size: " << ssize << ") ..." << endl;
+        if (params.model_test_and_tree == 0)
+            cout << " No. Model         -LnL         df  AIC          AICc         BIC" << endl;
+	}
+	if (params.print_site_lh) {
+		ofstream sitelh_out(sitelh_file.c_str());
+		if (!sitelh_out.is_open())
+			outError("Cannot write to file ", sitelh_file);
+		sitelh_out << model_names.size() << " " << in_tree->getAlnNSite() << endl;
+		sitelh_out.close();
+	}
+	vector<ModelInfo>::iterator it;
+	for (it = model_info.begin(); it != model_info.end(); it++) {
+		it->AIC_score = DBL_MAX;
+		it->AICc_score = DBL_MAX;
+		it->BIC_score = DBL_MAX;
 	}
 
+    int model_aic = -1, model_aicc = -1, model_bic = -1;
+    IntVector info_ids(model_names.size(), -1);
+    vector<IntVector> model_groups;
+    IntVector group_order;
+    int kernel_threads;
+    int num_groups = groupModels(params, in_tree, model_names, models_block, num_threads, max_cats,
+        model_groups, group_order, kernel_threads);
+
+    if (num_groups <= 1) {
+        DoubleVector best_scores(3, DBL_MAX);
+        IntVector model_ids;
+        for (model = 0; model < model_names.size(); model++)
+            model_ids.push_back(model);
+        if (params.model_test_prune && !params.model_test_and_tree && !params.model_test_separate_rate)
+            orderModelsForPruning(params, model_names, models_block, model_ids);
+        evaluateModelList(params, in_tree, model_names, model_ids, model_info, info_ids, fmodel, models_block,
+            num_threads, set_name, ssize, false, best_scores, model_aic, model_aicc, model_bic);
+    } else {
+#ifdef _OPENMP
+        if (set_name == "" && verbose_mode >= VB_MED)
+            cout << "Evaluating " << model_groups.size() << " model groups, " << num_groups
+                << " at a time with " << kernel_threads << " thread(s) each" << endl;
+        in_tree->aln->buildSeqStates(false);
+        vector<vector<ModelInfo> > group_info(model_groups.size(), model_info);
+        vector<IntVector> group_ids(model_groups.size(), IntVector(model_names.size(), -1));
+        vector<stringstream*> group_fmodel(model_groups.size());
+        StrVector table_rows(model_names.size());
+        IntVector model_group(model_names.size(), -1);
+        int group;
+        for (group = 0; group < model_groups.size(); group++) {
+            group_fmodel[group] = new stringstream;
+            if (params.model_test_prune)
+                orderModelsForPruning(params, model_names, models_block, model_groups[group]);
+            for (IntVector::iterator mit = model_groups[group].begin(); mit != model_groups[group].end(); mit++)
+                model_group[*mit] = group;
+        }
+        int nested = omp_get_nested();
+        omp_set_nested(kernel_threads > 1);
+#pragma omp parallel for schedule(dynamic) num_threads(num_groups)
+        for (int i = 0; i < model_groups.size(); i++) {
+            int group = group_order[i];
+            // the likelihood kernel of this group runs on its own subgroup of threads
+            omp_set_num_threads(kernel_threads);
+            // own random stream per group, so that the results do not depend on the thread schedule
+            int *group_randstream;
+            init_random(params.ran_seed + group, false, &group_randstream);
+            set_thread_random(group_randstream);
+            PhyloTree *tree = new PhyloTree;
+            tree->copyPhyloTree(in_tree);
+            tree->params = &params;
+            tree->optimize_by_newton = in_tree->optimize_by_newton;
+            tree->num_precision = in_tree->num_precision;
+            tree->setLikelihoodKernel(params.SSE, kernel_threads);
+            int group_aic, group_aicc, group_bic;
+            // prune only against the scores of this group, so that pruning does not depend on the thread timing
+            DoubleVector group_best(3, DBL_MAX);
+            evaluateModelList(params, tree, model_names, model_groups[group], group_info[group], group_ids[group],
+                *group_fmodel[group], models_block, kernel_threads, set_name, ssize, true, group_best,
+                group_aic, group_aicc, group_bic, &table_rows);
+            tree->deleteAllPartialLh();
+            delete tree;
+            set_thread_random(NULL);
+            finish_random(group_randstream);
+        }
+        omp_set_nested(nested);
+        omp_set_num_threads(num_threads);
+
+        // collect the results in the order of the candidate models
+        for (model = 0; model < model_names.size(); model++)
+            cout << table_rows[model];
+        cout.precision(3);
+        cout << fixed;
+        for (model = 0; model < model_names.size(); model++) {
+            group = model_group[model];
+            if (group_ids[group][model] < 0)
+                continue;
+            ModelInfo &info = group_info[group][group_ids[group][model]];
+            int model_id = -1;
+            for (int i = 0; i < model_info.size(); i++)
+                if (model_info[i].name == info.name) {
+                    model_id = i;
+                    break;
+                }
+            if (model_id >= 0) {
+                model_info[model_id] = info;
+            } else {
+                model_info.push_back(info);
+                model_id = model_info.size()-1;
+            }
+            info_ids[model] = model_id;
+            if (model_aic < 0 || model_info[model_id].AIC_score < model_info[model_aic].AIC_score)
+                model_aic = model_id;
+            if (model_aicc < 0 || model_info[model_id].AICc_score < model_info[model_aicc].AICc_score)
+                model_aicc = model_id;
+            if (model_bic < 0 || model_info[model_id].BIC_score < model_info[model_bic].BIC_score)
+                model_bic = model_id;
+        }
+        for (group = 0; group < model_groups.size(); group++) {
+            fmodel << group_fmodel[group]->str();
+            delete group_fmodel[group];
+        }
+#endif
+    }
+
     if (model_bic < 0) 
         outError("No models were examined! Please check messages above");
 
@@ -2027,23 +2547,6 @@ string testModel(Params &params, PhyloTree* in_tree, vector<ModelInfo> &model_in
 	delete [] model_rank;
 	delete [] scores;
 
-	delete model_fac;
-	delete subst_model;
-    int rate_type;
-	for (rate_type = 3; rate_type >= 0; rate_type--) {
-		delete rate_class[rate_type];
-    }
-    delete [] rate_class;
-    
-	for (rate_type = params.max_rate_cats-2; rate_type >= 0; rate_type--) {
-		delete rate_class_free[rate_type];
-    }
-    delete [] rate_class_free;
-
-	for (rate_type = params.max_rate_cats-2; rate_type >= 0; rate_type--) {
-		delete rate_class_freeinvar[rate_type];
-    }
-    delete [] rate_class_freeinvar;
     
 //	delete tree_hetero;
 //	delete tree_homo;
@@ -2381,6 +2884,12 @@ int mlecoef(double *cnts, double *rr, double bb, int kk,
 
 /* END CODE WAS TAKEN FROM CONSEL PROGRAM */
 
+/** number of multiscale replicates whose RELL scores are computed in one pass over the pattern likelihoods */
+#define AU_BLOCK_SIZE 16
+
+/** number of patterns of one chunk in the AU test RELL kernel, a multiple of all SIMD vector sizes */
+#define AU_PATTERN_CHUNK 256
+
 /**
     @param tree_lhs RELL score matrix of size #trees x #replicates
 */
@@ -2428,63 +2937,74 @@ void performAUTest(Params &params, PhyloTree *tree, double *pattern_lhs, vector<
 #else
     int *rstream = randstream;
 #endif
-    size_t boot;
+    size_t boot, b;
     int *boot_sample = aligned_alloc<int>(maxnptn);
     memset(boot_sample, 0, maxnptn*sizeof(int));
     
-    double *boot_sample_dbl = aligned_alloc<double>(maxnptn);
+    // weights of AU_BLOCK_SIZE consecutive replicates
+    double *boot_sample_dbl = aligned_alloc<double>(maxnptn*AU_BLOCK_SIZE);
+    memset(boot_sample_dbl, 0, maxnptn*AU_BLOCK_SIZE*sizeof(double));
+    double *tree_lh = new double[ntrees*AU_BLOCK_SIZE];
+    double chunk_lh[AU_BLOCK_SIZE];
     
 #ifdef _OPENMP
     #pragma omp for schedule(dynamic)
 #endif
     for (k = 0; k < nscales; k++) {
         string str = "SCALE=" + convertDoubleToString(r[k]);    
-		for (boot = 0; boot < nboot; boot++) {
-			tree->aln->createBootstrapAlignment(boot_sample, str.c_str(), rstream);
-            for (ptn = 0; ptn < maxnptn; ptn++)
-                boot_sample_dbl[ptn] = boot_sample[ptn];
-            double max_lh = -DBL_MAX, second_max_lh = -DBL_MAX;
-            int max_tid = -1;
-            for (tid = 0; tid < ntrees; tid++) {
-                double *pattern_lh = pattern_lhs + (tid*maxnptn);
-                double tree_lh;
-                if (params.SSE == LK_EIGEN) {
-                    tree_lh = 0.0;
+		for (boot = 0; boot < nboot; boot += AU_BLOCK_SIZE) {
+            size_t nblock = min((size_t)AU_BLOCK_SIZE, nboot - boot);
+            for (b = 0; b < AU_BLOCK_SIZE; b++) {
+                double *sample_dbl = boot_sample_dbl + b*maxnptn;
+                if (b < nblock) {
+                    tree->aln->createBootstrapAlignment(boot_sample, str.c_str(), rstream);
                     for (ptn = 0; ptn < nptn; ptn++)
-                        tree_lh += pattern_lh[ptn] * boot_sample_dbl[ptn];
-                } else {
-                    tree_lh = tree->dotProductDoubleCall(pattern_lh, boot_sample_dbl, nptn);
+                        sample_dbl[ptn] = boot_sample[ptn];
+                } else
+                    memset(sample_dbl, 0, nptn*sizeof(double));
+            }
+            
+            // RELL scores of all trees for the whole block: patterns are processed in chunks
+            // that stay in cache while they are reused by all replicates of the block
+            memset(tree_lh, 0, ntrees*AU_BLOCK_SIZE*sizeof(double));
+            for (size_t ptn_start = 0; ptn_start < nptn; ptn_start += AU_PATTERN_CHUNK) {
+                // entries beyond nptn are zero in both operands
+                int chunk = min(maxnptn, ptn_start + AU_PATTERN_CHUNK) - ptn_start;
+                for (tid = 0; tid < ntrees; tid++) {
+                    tree->dotProductMultiDoubleCall(pattern_lhs + (tid*maxnptn) + ptn_start,
+                            boot_sample_dbl + ptn_start, chunk, AU_BLOCK_SIZE, maxnptn, chunk_lh);
+                    for (b = 0; b < AU_BLOCK_SIZE; b++)
+                        tree_lh[tid*AU_BLOCK_SIZE+b] += chunk_lh[b];
                 }
-                // rescale lh
-                tree_lh /= r[k];
-                
-                // find the max and second max
-                if (tree_lh > max_lh) {
-                    second_max_lh = max_lh;
-                    max_lh = tree_lh;
-                    max_tid = tid;
-                } else if (tree_lh > second_max_lh)
-                    second_max_lh = tree_lh;
-                    
-                treelhs[(tid*nscales+k)*nboot + boot] = tree_lh; 
             }
+            // rescale lh
+            for (b = 0; b < ntrees*AU_BLOCK_SIZE; b++)
+                tree_lh[b] /= r[k];
             
-            // compute difference from max_lh
-            for (tid = 0; tid < ntrees; tid++) 
-                if (tid != max_tid)
-                    treelhs[(tid*nscales+k)*nboot + boot] = max_lh - treelhs[(tid*nscales+k)*nboot + boot];
-                else
-                    treelhs[(tid*nscales+k)*nboot + boot] = second_max_lh - max_lh;
-//            bp[k*ntrees+max_tid] += nboot_inv;
-        }
-        
-        // sort the replicates
-        for (tid = 0; tid < ntrees; tid++) {
-            quicksort<double,int>(treelhs + (tid*nscales+k)*nboot, 0, nboot-1);
+            for (b = 0; b < nblock; b++) {
+                double max_lh = -DBL_MAX, second_max_lh = -DBL_MAX;
+                int max_tid = -1;
+                // find the max and second max
+                for (tid = 0; tid < ntrees; tid++) {
+                    double lh = tree_lh[tid*AU_BLOCK_SIZE+b];
+                    if (lh > max_lh) {
+                        second_max_lh = max_lh;
+                        max_lh = lh;
+                        max_tid = tid;
+                    } else if (lh > second_max_lh)
+                        second_max_lh = lh;
+                }
+                // compute difference from max_lh
+                for (tid = 0; tid < ntrees; tid++) 
+                    if (tid != max_tid)
+                        treelhs[(tid*nscales+k)*nboot + boot+b] = max_lh - tree_lh[tid*AU_BLOCK_SIZE+b];
+                    else
+                        treelhs[(tid*nscales+k)*nboot + boot+b] = second_max_lh - max_lh;
+            }
         }
-        
     }
 
+    delete [] tree_lh;
     aligned_free(boot_sample_dbl);
     aligned_free(boot_sample);
 
@@ -2493,6 +3013,13 @@ void performAUTest(Params &params, PhyloTree *tree, double *pattern_lhs, vector<
     }
 #endif
 
+    // sort the replicates, one task per tree and scale
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic)
+#endif
+    for (int task = 0; task < (int)(ntrees*nscales); task++)
+        quicksort<double,int>(treelhs + task*nboot, 0, nboot-1);
+
 //    if (verbose_mode >= VB_MED) {
 //        cout << "scale";
 //        for (k = 0; k < nscales; k++)
@@ -2699,7 +3226,7 @@ void evaluateTrees(Params &params, IQTree *tree, vector<TreeInfo> &info, IntVect
 
 	double time_start = getRealTime();
 
-	int *boot_samples = NULL;
+	BootWeights boot_samples;
 	size_t boot;
 	//double *saved_tree_lhs = NULL;
 	double *tree_lhs = NULL; // RELL score matrix of size #trees x #replicates
@@ -2712,7 +3239,7 @@ void evaluateTrees(Params &params, IQTree *tree, vector<TreeInfo> &info, IntVect
     size_t maxnptn = get_safe_upper_limit(nptn);
     
 	if (params.topotest_replicates && ntrees > 1) {
-		size_t mem_size = (size_t)params.topotest_replicates*nptn*sizeof(int) +
+		size_t mem_size = BootWeights::getMemoryRequired(params.topotest_replicates, nptn, BWS_UINT16) +
 				ntrees*params.topotest_replicates*sizeof(double) +
 				(nptn + ntrees*3 + params.topotest_replicates*2)*sizeof(double) +
 				ntrees*sizeof(TreeInfo) +
@@ -2721,19 +3248,26 @@ void evaluateTrees(Params &params, IQTree *tree, vector<TreeInfo> &info, IntVect
 		if (mem_size > getMemorySize()-100000)
 			outWarning("The required memory does not fit in RAM!");
 		cout << "Creating " << params.topotest_replicates << " bootstrap replicates..." << endl;
-		if (!(boot_samples = new int [params.topotest_replicates*nptn]))
-			outError(ERR_NO_MEMORY);
+		boot_samples.init(params.topotest_replicates, nptn);
 #ifdef _OPENMP
         #pragma omp parallel private(boot) if(nptn > 10000)
         {
         int *rstream;
         init_random(params.ran_seed + omp_get_thread_num(), false, &rstream);
-        #pragma omp for schedule(static)
 #else
         int *rstream = randstream;
 #endif
-		for (boot = 0; boot < params.topotest_replicates; boot++)
-			tree->aln->createBootstrapAlignment(boot_samples + (boot*nptn), params.bootstrap_spec, rstream);
+        IntVector this_sample(nptn);
+#ifdef _OPENMP
+        #pragma omp for schedule(static)
+#endif
+		for (boot = 0; boot < params.topotest_replicates; boot++) {
+			tree->aln->createBootstrapAlignment(&this_sample[0], params.bootstrap_spec, rstream);
+#ifdef _OPENMP
+			#pragma omp critical
+#endif
+			boot_samples.setSample(boot, this_sample);
+		}
 #ifdef _OPENMP
         finish_random(rstream);
         }
@@ -2760,6 +3294,11 @@ void evaluateTrees(Params &params, IQTree *tree, vector<TreeInfo> &info, IntVect
 	}
 	int tree_index, tid, tid2;
 	info.resize(ntrees);
+	// with fixed branch lengths, clades shared between trees are computed only once
+	bool use_clade_cache = params.fixed_branch_length && ntrees > 1 && !tree->isSuperTree() &&
+			params.lh_mem_save == LM_PER_NODE;
+	size_t clade_cache_max = getMemorySize() / 4;
+	tree->clade_cache_hits = tree->clade_cache_misses = 0;
 	//for (MTreeSet::iterator it = trees.begin(); it != trees.end(); it++, tree_index++) {
 	for (tree_index = 0, tid = 0; tree_index < distinct_ids.size(); tree_index++) {
 
@@ -2784,6 +3323,8 @@ void evaluateTrees(Params &params, IQTree *tree, vector<TreeInfo> &info, IntVect
 		tree->fixNegativeBranch(false);
 		if (!params.fixed_branch_length) {
 			tree->setCurScore(tree->optimizeAllBranches(100, 0.001));
+		} else if (use_clade_cache) {
+			tree->setCurScore(tree->computeLikelihoodCladeCache(clade_cache_max));
 		} else {
 			tree->setCurScore(tree->computeLikelihood());
 		}
@@ -2818,19 +3359,19 @@ void evaluateTrees(Params &params, IQTree *tree, vector<TreeInfo> &info, IntVect
 		}
 		// now compute RELL scores
 		orig_tree_lh[tid] = tree->getCurScore();
-		double *tree_lhs_offset = tree_lhs + (tid*params.topotest_replicates);
-		for (boot = 0; boot < params.topotest_replicates; boot++) {
-			double lh = 0.0;
-			int *this_boot_sample = boot_samples + (boot*nptn);
-			for (size_t ptn = 0; ptn < nptn; ptn++)
-				lh += pattern_lh[ptn] * this_boot_sample[ptn];
-			tree_lhs_offset[boot] = lh;
-		}
+		boot_samples.computeRELL(pattern_lh, tree_lhs + (tid*params.topotest_replicates),
+				0, params.topotest_replicates);
 		tid++;
 	}
 
 	assert(tid == ntrees);
 
+	if (use_clade_cache) {
+		cout << "Clade cache: " << tree->clade_cache_hits << " of " << tree->clade_cache_hits + tree->clade_cache_misses
+			 << " partial likelihood vectors reused" << endl;
+		tree->clearCladeCache();
+	}
+
 	if (params.topotest_replicates && ntrees > 1) {
 		double *tree_probs = new double[ntrees];
 		memset(tree_probs, 0, ntrees*sizeof(double));
@@ -3061,8 +3602,6 @@ void evaluateTrees(Params &params, IQTree *tree, vector<TreeInfo> &info, IntVect
 		delete [] tree_lhs;
 	//if (saved_tree_lhs)
 	//	delete [] saved_tree_lhs;
-	if (boot_samples)
-		delete [] boot_samples;
 
 	if (params.print_tree_lh) {
 		scoreout.close();
@@ -3082,5 +3621,92 @@ void evaluateTrees(Params &params, IQTree *tree) {
 	evaluateTrees(params, tree, info, distinct_ids);
 }
 
+/**
+ * parse a tree of the evaluation server and check its taxa against the alignment of tree
+ * @return error message, empty if the tree can be read by PhyloTree::readTree()
+ */
+static string checkServedTree(string &line, bool is_rooted, IQTree *tree) {
+	MTree check_tree;
+	istringstream in(line);
+	try {
+		check_tree.parseTree(in, is_rooted);
+	} catch (string str) {
+		return str;
+	} catch (bad_alloc) {
+		return ERR_NO_MEMORY;
+	}
+	StrVector taxname;
+	check_tree.getTaxaName(taxname);
+	Alignment *aln = tree->aln;
+	IntVector found(aln->getNSeq(), 0);
+	for (StrVector::iterator it = taxname.begin(); it != taxname.end(); it++) {
+		if (*it == ROOT_NAME ||
+				find(tree->removed_seqs.begin(), tree->removed_seqs.end(), *it) != tree->removed_seqs.end())
+			continue;
+		int seq = aln->getSeqID(*it);
+		if (seq < 0)
+			return "Tree taxon " + (*it) + " does not appear in the alignment";
+		if (found[seq]++)
+			return "Tree taxon " + (*it) + " appears more than once";
+	}
+	for (int seq = 0; seq < aln->getNSeq(); seq++)
+		if (!found[seq])
+			return "Alignment sequence " + aln->getSeqName(seq) + " does not appear in the tree";
+	return "";
+}
+
+void serveTreeEvaluation(Params &params, IQTree *tree) {
+	cout << endl << "Serving tree evaluation requests on stdin..." << endl;
+	// only the responses go to stdout from now on
+	VerboseMode saved_verbose_mode = verbose_mode;
+	verbose_mode = VB_QUIET;
+	string line;
+	int request = 0;
+	while (getline(cin, line)) {
+		// strip trailing white spaces and CR
+		size_t end = line.find_last_not_of(" \t\r");
+		if (end == string::npos)
+			continue;
+		line.erase(end+1);
+		size_t start = line.find_first_not_of(" \t");
+		request++;
+		if (line[start] != '(' || line[end] != ';') {
+			printf("%d\tERROR\tNot a Newick tree\n", request);
+			fflush(stdout);
+			continue;
+		}
+		string err = checkServedTree(line, params.is_rooted, tree);
+		if (!err.empty()) {
+			printf("%d\tERROR\t%s\n", request, err.c_str());
+			fflush(stdout);
+			continue;
+		}
+		double start_time = getRealTime();
+		istringstream in(line);
+		tree->freeNode();
+		tree->readTree(in, params.is_rooted);
+		tree->setAlignment(tree->aln);
+		tree->setRootNode(params.root);
+		if (tree->isSuperTree())
+			((PhyloSuperTree*) tree)->mapTrees();
+
+		tree->initializeAllPartialLh();
+		tree->fixNegativeBranch(false);
+		if (!params.fixed_branch_length) {
+			tree->setCurScore(tree->optimizeAllBranches(100, 0.001));
+		} else {
+			tree->setCurScore(tree->computeLikelihood());
+		}
+		ostringstream tree_str;
+		tree->printTree(tree_str);
+		cout << "Request " << request << " / LogL: " << tree->getCurScore()
+			 << " / Time: " << getRealTime() - start_time << " sec" << endl;
+		printf("%d\t%.6f\t%s\n", request, tree->getCurScore(), tree_str.str().c_str());
+		fflush(stdout);
+	}
+	verbose_mode = saved_verbose_mode;
+	cout << request << " tree evaluation requests served" << endl;
+}
+
 
 
@@ -133,6 +133,22 @@ void evaluateTrees(Params &params, IQTree *tree, vector<TreeInfo> &info, IntVect
 
 void evaluateTrees(Params &params, IQTree *tree);
 
+/**
+ * Tree evaluation server: read Newick trees from stdin, one per line, and score each one
+ * with the current model until end of input. For the n-th tree (starting from 1) one line
+ * "n<TAB>logL<TAB>tree with branch lengths" is written to stdout, or "n<TAB>ERROR<TAB>message"
+ * if the line is not a valid Newick tree or its taxa do not match the alignment; the server
+ * then goes on with the next line. Branch lengths are optimized unless -fixbr is given.
+ * Screen output is suppressed while serving, the log file is still written.
+ * Example session on example.phy (requests on the left, replies on the right):
+ *   (A,(B,C);                  1  ERROR  Expecting ')', but found ';' instead (line 1 column 9)
+ *   (Foo,(LngfishSA,...);      2  ERROR  Tree taxon Foo does not appear in the alignment
+ *   (LngfishAu,(LngfishSA,...); 3  -21156.449602  (LngfishAu:0.1684883235,(LngfishSA:...
+ * @param params program parameters
+ * @param tree tree with the fitted model
+ */
+void serveTreeEvaluation(Params &params, IQTree *tree);
+
 /**
     get sequence type for a model name
     @param model_name model name string
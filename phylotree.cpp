@@ -31,6 +31,7 @@
 #include "phylosupertreeplen.h"
 #include "upperbounds.h"
 #include "MPIHelper.h"
+#include "bootweights.h"
 #include "model/modelmixture.h"
 
 const int LH_MIN_CONST = 1;
@@ -102,6 +103,9 @@ void PhyloTree::init() {
     max_lh_slots = 0;
     save_all_trees = 0;
     nodeBranchDists = NULL;
+    branch_test_samples = NULL;
+    clade_cache_bytes = 0;
+    clade_cache_hits = clade_cache_misses = 0;
     // FOR: upper bounds
     mlCheck = 0;
     skippedNNIub = 0;
@@ -119,6 +123,9 @@ void PhyloTree::init() {
     params = NULL;
     current_scaling = 1.0;
     is_opt_scaling = false;
+    topo_hash = 0;
+    topo_hash_valid = false;
+    topo_key_all = 0;
     num_partial_lh_computations = 0;
     vector_size = 0;
 }
@@ -186,6 +193,7 @@ void myPartitionsDestroy(partitionList *pl) {
 }
 
 PhyloTree::~PhyloTree() {
+    clearCladeCache();
     if (nni_scale_num)
         aligned_free(nni_scale_num);
     nni_scale_num = NULL;
@@ -373,6 +381,7 @@ void PhyloTree::setRootNode(const char *my_root) {
 void PhyloTree::readTreeString(const string &tree_string) {
 	stringstream str(tree_string);
 	freeNode();
+    topo_hash_valid = false;
     
     // bug fix 2016-04-14: in case taxon name happens to be ID
 	MTree::readTree(str, rooted);
@@ -397,6 +406,7 @@ void PhyloTree::readTreeStringSeqName(const string &tree_string) {
 //	str(tree_string);
 //	str.seekg(0, ios::beg);
 	freeNode();
+    topo_hash_valid = false;
 	readTree(str, rooted);
 //    assignLeafNames();
 	setAlignment(aln);
@@ -515,6 +525,7 @@ Node* PhyloTree::newNode(int node_id, int node_name) {
 }
 
 void PhyloTree::clearAllPartialLH(bool make_null) {
+    partial_info_cache.newVersion();
     if (!root)
         return;
     ((PhyloNode*) root->neighbors[0]->node)->clearAllPartialLh(make_null, (PhyloNode*) root);
@@ -611,6 +622,8 @@ void PhyloTree::restoreBranchLengths(DoubleVector &lenvec, int startid, PhyloNod
  */
 void PhyloTree::initializeAllPartialPars() {
     int index = 0;
+    if (aln->ordered_pattern.empty())
+        aln->orderPatternByNumChars();
     initializeAllPartialPars(index);
     clearAllPartialLH();
     //assert(index == (nodeNum - 1)*2);
@@ -644,13 +657,14 @@ void PhyloTree::initializeAllPartialPars(int &index, PhyloNode *node, PhyloNode
     FOR_NEIGHBOR_IT(node, dad, it)initializeAllPartialPars(index, (PhyloNode*) (*it)->node, node);
 }
 
-#define SIMD_BITS 256
-
 size_t PhyloTree::getBitsBlockSize() {
+    // the bit-vector layout with weight classes is only known after ordering the patterns,
+    // which the parsimony setup (initializeAllPartialPars(), initializeAllPartialLh()) does
     // reserve the last entry for parsimony score
 //    return (aln->num_states * aln->size() + UINT_BITS - 1) / UINT_BITS + 1;
-    size_t len = aln->getMaxNumStates() * ((max(aln->size(), (size_t)aln->num_informative_sites) + SIMD_BITS - 1) / UINT_BITS) + 4;
-    len = ((len+7)/8)*8;
+    size_t len = aln->getMaxNumStates() * ((max(aln->size(), (size_t)aln->num_parsimony_sites) + PARS_BLOCK_BITS - 1) / UINT_BITS) + 4;
+    // keep every block aligned to the widest SIMD vector
+    len = ((len + PARS_BLOCK_BITS/UINT_BITS - 1) / (PARS_BLOCK_BITS/UINT_BITS)) * (PARS_BLOCK_BITS/UINT_BITS);
     return len;
 }
 
@@ -688,13 +702,14 @@ int PhyloTree::computeParsimony() {
  likelihood function
  ****************************************************************************/
 
-size_t PhyloTree::getBufferPartialLhSize() {
+size_t PhyloTree::getBufferPartialLhSize(size_t ncat_mix) {
     const size_t VECTOR_SIZE = 8; // TODO, adjusted
-    size_t ncat_mix = site_rate->getNRate() * ((model_factory->fused_mix_rate)? 1 : model->getNMixtures());
-    size_t block = model->num_states * ncat_mix;
-    size_t buffer_size = get_safe_upper_limit(block * model->num_states * 2) * aln->getNSeq();
+    if (ncat_mix == 0)
+        ncat_mix = site_rate->getNRate() * ((model_factory->fused_mix_rate)? 1 : model->getNMixtures());
+    size_t block = aln->num_states * ncat_mix;
+    size_t buffer_size = get_safe_upper_limit(block * aln->num_states * 2) * aln->getNSeq();
     buffer_size += get_safe_upper_limit(block *(aln->STATE_UNKNOWN+1)) * (aln->getNSeq()+1);
-    buffer_size += (block*2+model->num_states)*VECTOR_SIZE*num_threads;
+    buffer_size += (block*2+aln->num_states)*VECTOR_SIZE*num_threads;
     return buffer_size;
 }
 
@@ -724,6 +739,9 @@ void PhyloTree::initializeAllPartialLh() {
     }
     if (!ptn_invar)
         ptn_invar = aligned_alloc<double>(mem_size);
+    // for the size of the partial parsimony vectors
+    if (aln->ordered_pattern.empty())
+        aln->orderPatternByNumChars();
     initializeAllPartialLh(index, indexlh);
     if (params->lh_mem_save == LM_MEM_SAVE)
         mem_slots.init(this, max_lh_slots);
@@ -754,6 +772,7 @@ void PhyloTree::deleteAllPartialLh() {
     if (nni_partial_lh)
         aligned_free(nni_partial_lh);
     nni_partial_lh = NULL;
+    partial_info_cache.release();
 
 	if (ptn_invar)
 		aligned_free(ptn_invar);
@@ -809,12 +828,15 @@ uint64_t PhyloTree::getMemoryRequired(size_t ncategory, bool full_mem) {
 
     // memory for UFBoot
     if (params->gbo_replicates)
-        mem_size += params->gbo_replicates*nptn*sizeof(BootValType);
+        mem_size += BootWeights::getMemoryRequired(params->gbo_replicates, nptn, params->ufboot_weight_storage);
 
     // memory for model
     if (model)
     	mem_size += model->getMemoryRequired();
 
+    // memory for the transition matrices of a traversal, grows with the number of mixture classes
+    mem_size += getBufferPartialLhSize(scale_block_size / nptn) * sizeof(double);
+
     int64_t lh_scale_size = block_size * sizeof(double) + scale_block_size * sizeof(UBYTE);
 
     max_lh_slots = leafNum-2;
@@ -1206,6 +1228,62 @@ double PhyloTree::computePatternLhCat(SiteLoglType wsl) {
     return score;
 }
 
+double PhyloTree::computeEMWeights(double *lh_cat, size_t ncat, double *weight, double invar_weight, double *new_weight, double *post) {
+    size_t ptn, nptn = aln->getNPattern();
+    size_t c;
+    double logl = 0.0;
+
+    memset(new_weight, 0, ncat*sizeof(double));
+
+#ifdef _OPENMP
+#pragma omp parallel num_threads(num_threads) private(ptn, c)
+#endif
+    {
+        double *thread_sum = aligned_alloc<double>(ncat);
+        double *buffer = aligned_alloc<double>(ncat);
+        double thread_logl = 0.0;
+        memset(thread_sum, 0, ncat*sizeof(double));
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+        for (ptn = 0; ptn < nptn; ptn++) {
+            double *this_lh = lh_cat + ptn*ncat;
+            double *this_post = (post) ? post + ptn*ncat : buffer;
+            if (weight) {
+                for (c = 0; c < ncat; c++)
+                    this_post[c] = this_lh[c] * weight[c];
+            } else if (this_post != this_lh)
+                memcpy(this_post, this_lh, ncat*sizeof(double));
+            double lh_ptn = ptn_invar[ptn] * invar_weight;
+            for (c = 0; c < ncat; c++)
+                lh_ptn += this_post[c];
+            assert(lh_ptn != 0.0);
+            thread_logl += ptn_freq[ptn] * log(lh_ptn);
+            lh_ptn = ptn_freq[ptn] / lh_ptn;
+            // transform into posterior probabilities of each category
+            for (c = 0; c < ncat; c++) {
+                this_post[c] *= lh_ptn;
+                thread_sum[c] += this_post[c];
+            }
+        }
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+        {
+            for (c = 0; c < ncat; c++)
+                new_weight[c] += thread_sum[c];
+            logl += thread_logl;
+        }
+        aligned_free(buffer);
+        aligned_free(thread_sum);
+    }
+
+    double nsite = getAlnNSite();
+    for (c = 0; c < ncat; c++)
+        new_weight[c] /= nsite;
+    return logl;
+}
+
 void PhyloTree::computePatternStateFreq(double *ptn_state_freq) {
     assert(getModel()->isMixture());
     computePatternLhCat(WSL_MIXTURE);
@@ -2997,6 +3075,15 @@ void PhyloTree::doNNI(NNIMove &move, bool clearLH) {
         reorientPartialLh(node12_it, node1);
         reorientPartialLh(node21_it, node2);
     }
+
+    // update topology hash: only the split of the central branch changes
+    if (topo_hash_valid) {
+        uint64_t swap_key = ((PhyloNeighbor*)node1Nei)->topo_key ^ ((PhyloNeighbor*)node2Nei)->topo_key;
+        topo_hash -= splitTopoHash(node12_it->topo_key);
+        node12_it->topo_key ^= swap_key;
+        node21_it->topo_key ^= swap_key;
+        topo_hash += splitTopoHash(node12_it->topo_key);
+    }
     
     // do the NNI swap
     node1->updateNeighbor(node1Nei_it, node2Nei);
@@ -3052,6 +3139,146 @@ void PhyloTree::doNNI(NNIMove &move, bool clearLH) {
     }
 }
 
+/**
+    splitmix64 finalizer, used to derive the taxon keys and to mix the split keys
+*/
+inline uint64_t mixTopoKey(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+uint64_t PhyloTree::splitTopoHash(uint64_t key) {
+    // a split and its complement must give the same contribution
+    return mixTopoKey(min(key, key ^ topo_key_all));
+}
+
+uint64_t PhyloTree::computeTopoKeys(PhyloNode *node, PhyloNode *dad) {
+    // the keys do not depend on the random seed, so that hashing does not alter the search
+    uint64_t key = (node->isLeaf()) ? mixTopoKey((node->id + 1) * 0x9e3779b97f4a7c15ULL) : 0;
+    FOR_NEIGHBOR_IT(node, dad, it) {
+        PhyloNeighbor *nei = (PhyloNeighbor*)(*it);
+        nei->topo_key = computeTopoKeys((PhyloNode*)nei->node, node);
+        key ^= nei->topo_key;
+    }
+    return key;
+}
+
+void PhyloTree::sumTopoHash(PhyloNode *node, PhyloNode *dad) {
+    FOR_NEIGHBOR_IT(node, dad, it) {
+        PhyloNeighbor *nei = (PhyloNeighbor*)(*it);
+        PhyloNeighbor *nei_back = (PhyloNeighbor*)nei->node->findNeighbor(node);
+        nei_back->topo_key = nei->topo_key ^ topo_key_all;
+        if (!node->isLeaf() && !nei->node->isLeaf())
+            topo_hash += splitTopoHash(nei->topo_key);
+        sumTopoHash((PhyloNode*)nei->node, node);
+    }
+}
+
+uint64_t PhyloTree::computeTopologyHash() {
+    topo_key_all = computeTopoKeys((PhyloNode*)root, NULL);
+    topo_hash = 0;
+    sumTopoHash((PhyloNode*)root, NULL);
+    topo_hash_valid = true;
+    return topo_hash;
+}
+
+/****************************************************************************
+        Clade cache for evaluating many trees with fixed branch lengths
+ ****************************************************************************/
+
+void PhyloTree::computeCladeKeys(PhyloNode *node, PhyloNode *dad, vector<CladeKey> &keys) {
+    CladeKey key;
+    // children are combined by a sum, so that their order does not matter
+    key.hash = key.check = 0;
+    FOR_NEIGHBOR_IT(node, dad, it) {
+        computeCladeKeys((PhyloNode*)(*it)->node, node, keys);
+        CladeKey &child = keys[(*it)->node->id];
+        uint64_t len;
+        memcpy(&len, &(*it)->length, sizeof(len));
+        key.hash += mixTopoKey(child.hash ^ mixTopoKey(len));
+        key.check += mixTopoKey(child.check + len * 0x9e3779b97f4a7c15ULL);
+    }
+    if (node->isLeaf()) {
+        key.hash = mixTopoKey((node->id + 1) * 0x9e3779b97f4a7c15ULL);
+        key.check = mixTopoKey(key.hash ^ 0x2545f4914f6cdd1dULL);
+    } else {
+        key.hash = mixTopoKey(key.hash);
+        key.check = mixTopoKey(key.check ^ 0x2545f4914f6cdd1dULL);
+    }
+    keys[node->id] = key;
+}
+
+void PhyloTree::restoreCladePartialLh(PhyloNode *node, PhyloNode *dad, vector<CladeKey> &keys) {
+    FOR_NEIGHBOR_IT(node, dad, it) {
+        PhyloNode *child = (PhyloNode*)(*it)->node;
+        if (child->isLeaf())
+            continue;
+        PhyloNeighbor *nei = (PhyloNeighbor*)(*it);
+        CladeKey &key = keys[child->id];
+        CladePartialLhMap::iterator found = clade_cache.find(key.hash);
+        if (found != clade_cache.end() && found->second.check == key.check) {
+            reorientPartialLh(nei, node);
+            memcpy(nei->partial_lh, found->second.partial_lh, getPartialLhBytes());
+            memcpy(nei->scale_num, found->second.scale_num, getScaleNumBytes());
+            nei->lh_scale_factor = found->second.lh_scale_factor;
+            nei->partial_lh_computed |= 1;
+            clade_cache_hits++;
+        } else
+            restoreCladePartialLh(child, node, keys);
+    }
+}
+
+void PhyloTree::storeCladePartialLh(PhyloNode *node, PhyloNode *dad, vector<CladeKey> &keys, size_t max_bytes) {
+    FOR_NEIGHBOR_IT(node, dad, it) {
+        PhyloNode *child = (PhyloNode*)(*it)->node;
+        PhyloNeighbor *nei = (PhyloNeighbor*)(*it);
+        if (child->isLeaf() || !nei->partial_lh || !(nei->partial_lh_computed & 1))
+            continue;
+        CladeKey &key = keys[child->id];
+        if (clade_cache.find(key.hash) != clade_cache.end())
+            // restored from the cache, or a (very unlikely) hash collision
+            continue;
+        clade_cache_misses++;
+        size_t bytes = getPartialLhBytes() + getScaleNumBytes();
+        if (clade_cache_bytes + bytes <= max_bytes) {
+            CladePartialLh entry;
+            entry.check = key.check;
+            entry.partial_lh = aligned_alloc<double>(getPartialLhSize());
+            entry.scale_num = aligned_alloc<UBYTE>(getScaleNumSize());
+            memcpy(entry.partial_lh, nei->partial_lh, getPartialLhBytes());
+            memcpy(entry.scale_num, nei->scale_num, getScaleNumBytes());
+            entry.lh_scale_factor = nei->lh_scale_factor;
+            clade_cache[key.hash] = entry;
+            clade_cache_bytes += bytes;
+        }
+        storeCladePartialLh(child, node, keys, max_bytes);
+    }
+}
+
+double PhyloTree::computeLikelihoodCladeCache(size_t max_bytes) {
+    ASSERT(root->isLeaf() && !isSuperTree() && params->lh_mem_save == LM_PER_NODE);
+    vector<CladeKey> keys(nodeNum);
+    computeCladeKeys((PhyloNode*)root, NULL, keys);
+    clearAllPartialLH();
+    // partial likelihoods point away from the root, as initializeAllPartialLh() allocated them
+    current_it = (PhyloNeighbor*)root->neighbors[0];
+    current_it_back = (PhyloNeighbor*)current_it->node->findNeighbor(root);
+    restoreCladePartialLh((PhyloNode*)root, NULL, keys);
+    double score = computeLikelihood();
+    storeCladePartialLh((PhyloNode*)root, NULL, keys, max_bytes);
+    return score;
+}
+
+void PhyloTree::clearCladeCache() {
+    for (CladePartialLhMap::iterator it = clade_cache.begin(); it != clade_cache.end(); it++) {
+        aligned_free(it->second.partial_lh);
+        aligned_free(it->second.scale_num);
+    }
+    clade_cache.clear();
+    clade_cache_bytes = 0;
+}
+
 void PhyloTree::changeNNIBrans(NNIMove nnimove) {
 	PhyloNode *node1 = nnimove.node1;
 	PhyloNode *node2 = nnimove.node2;
@@ -3407,6 +3634,8 @@ double PhyloTree::optimizeSPR_old(double cur_score, PhyloNode *node, PhyloNode *
  */
 double PhyloTree::swapSPR_old(double cur_score, int cur_depth, PhyloNode *node1, PhyloNode *dad1, PhyloNode *orig_node1,
         PhyloNode *orig_node2, PhyloNode *node2, PhyloNode *dad2, vector<PhyloNeighbor*> &spr_path) {
+    // SPR changes the splits along the whole path, the topology hash must be recomputed
+    topo_hash_valid = false;
     PhyloNeighbor *node1_nei = (PhyloNeighbor*) node1->findNeighbor(dad1);
     PhyloNeighbor *dad1_nei = (PhyloNeighbor*) dad1->findNeighbor(node1);
     double node1_dad1_len = node1_nei->length;
@@ -3585,6 +3814,8 @@ double PhyloTree::optimizeSPR(double cur_score, PhyloNode *node, PhyloNode *dad)
  */
 double PhyloTree::swapSPR(double cur_score, int cur_depth, PhyloNode *node1, PhyloNode *dad1, PhyloNode *orig_node1,
         PhyloNode *orig_node2, PhyloNode *node2, PhyloNode *dad2, vector<PhyloNeighbor*> &spr_path) {
+    // SPR changes the splits along the whole path, the topology hash must be recomputed
+    topo_hash_valid = false;
 
     PhyloNeighbor *node1_nei = (PhyloNeighbor*) node1->findNeighbor(dad1);
     PhyloNeighbor *dad1_nei = (PhyloNeighbor*) dad1->findNeighbor(node1);
@@ -3716,6 +3947,8 @@ double PhyloTree::swapSPR(double cur_score, int cur_depth, PhyloNode *node1, Phy
 }
 
 double PhyloTree::assessSPRMove(double cur_score, const SPRMove &spr) {
+    // SPR changes the splits along the whole path, the topology hash must be recomputed
+    topo_hash_valid = false;
 
     PhyloNode *dad = spr.prune_dad;
     PhyloNode *node = spr.prune_node;
@@ -4264,10 +4497,25 @@ double PhyloTree::testOneBranch(double best_score, double *pattern_lh, int reps,
     lbp_support = 0.0;
     int times = max(reps, lbp_reps);
 
+    // RELL scores of the two NNI alternatives for the shared replicates
+    DoubleVector rell1, rell2;
+    if (branch_test_samples && times > 0) {
+        ASSERT(branch_test_samples->size() == times);
+        rell1.resize(times);
+        rell2.resize(times);
+        branch_test_samples->computeRELL(pat_lh[1], &rell1[0], 0, times);
+        branch_test_samples->computeRELL(pat_lh[2], &rell2[0], 0, times);
+    }
+
     for (int i = 0; i < times; i++) {
         double lh_new[NUM_NNI];
         // resampling estimated log-likelihood (RELL)
-        resampleLh(pat_lh, lh_new);
+        if (branch_test_samples) {
+            lh_new[0] = branch_test_rell[i];
+            lh_new[1] = rell1[i];
+            lh_new[2] = rell2[i];
+        } else
+            resampleLh(pat_lh, lh_new);
         if (lh_new[0] > lh_new[1] && lh_new[0] > lh_new[2])
             lbp_support += 1.0;
         double cs[NUM_NNI], cs_best, cs_2nd_best;
@@ -4311,6 +4559,7 @@ double PhyloTree::testOneBranch(double best_score, double *pattern_lh, int reps,
 int PhyloTree::testAllBranches(int threshold, double best_score, double *pattern_lh, int reps, int lbp_reps, bool aLRT_test, bool aBayes_test,
         PhyloNode *node, PhyloNode *dad) {
     int num_low_support = 0;
+    bool first_call = !node;
     if (!node) {
         node = (PhyloNode*) root;
         root->neighbors[0]->node->name = "";
@@ -4323,6 +4572,22 @@ int PhyloTree::testAllBranches(int threshold, double best_score, double *pattern
 			params->nni5 = nni5;
 			save_all_trees = tmp;
         }
+        int times = max(reps, lbp_reps);
+        size_t nptn = getAlnNPattern();
+        if (times > 0 && BootWeights::getMemoryRequired(times, nptn, BWS_UINT16) < getMemorySize()/4) {
+            // draw the replicates once for all branches, so that testOneBranch() only has to
+            // compute the RELL scores of the two NNI alternatives with the blocked kernel;
+            // otherwise every branch draws its own replicates in resampleLh()
+            branch_test_samples = new BootWeights;
+            branch_test_samples->init(times, nptn);
+            IntVector boot_freq;
+            for (int i = 0; i < times; i++) {
+                aln->createBootstrapAlignment(boot_freq, params->bootstrap_spec);
+                branch_test_samples->setSample(i, boot_freq);
+            }
+            branch_test_rell.resize(times);
+            branch_test_samples->computeRELL(pattern_lh, &branch_test_rell[0], 0, times);
+        }
     }
     if (dad && !node->isLeaf() && !dad->isLeaf()) {
         double lbp_support, aLRT_support, aBayes_support;
@@ -4352,6 +4617,11 @@ int PhyloTree::testAllBranches(int threshold, double best_score, double *pattern
     FOR_NEIGHBOR_IT(node, dad, it)
         num_low_support += testAllBranches(threshold, best_score, pattern_lh, reps, lbp_reps, aLRT_test, aBayes_test, (PhyloNode*) (*it)->node, node);
 
+    if (first_call && branch_test_samples) {
+        delete branch_test_samples;
+        branch_test_samples = NULL;
+        branch_test_rell.clear();
+    }
     return num_low_support;
 }
 
@@ -45,6 +45,8 @@
 #include "checkpoint.h"
 #include "constrainttree.h"
 #include "memslot.h"
+#include "bootweights.h"
+#include "partialinfocache.h"
 
 #define BOOT_VAL_FLOAT
 #define BootValType float
@@ -340,6 +342,25 @@ public:
 // END traversal information
 // ********************************************
 
+/**
+    key of a clade: subtree topology together with all branch lengths inside it,
+    as two independent 64-bit hashes
+*/
+struct CladeKey {
+    uint64_t hash;
+    uint64_t check;
+};
+
+/** partial likelihoods of one clade kept for reuse across trees */
+struct CladePartialLh {
+    uint64_t check;
+    double *partial_lh;
+    UBYTE *scale_num;
+    double lh_scale_factor;
+};
+
+typedef unordered_map<uint64_t, CladePartialLh> CladePartialLhMap;
+
 /**
 Phylogenetic Tree class
 
@@ -535,6 +556,9 @@ public:
     template <class Numeric, class VectorClass>
     Numeric dotProductSIMD(Numeric *x, Numeric *y, int size);
 
+    template <class Numeric, class VectorClass>
+    void dotProductMultiSIMD(Numeric *x, Numeric *y, int size, int ny, size_t y_stride, Numeric *res);
+
     typedef BootValType (PhyloTree::*DotProductType)(BootValType *x, BootValType *y, int size);
     DotProductType dotProduct;
 
@@ -543,6 +567,18 @@ public:
 
     double dotProductDoubleCall(double *x, double *y, int size);
 
+    typedef void (PhyloTree::*DotProductMultiDoubleType)(double *x, double *y, int size, int ny, size_t y_stride, double *res);
+    DotProductMultiDoubleType dotProductMultiDouble;
+
+    /**
+     * dot products of one vector with several vectors
+     * @param x vector of length size, aligned
+     * @param y ny vectors of length size, vector j starts at y + j*y_stride, aligned
+     * @param size vector length, a multiple of the SIMD vector size
+     * @param[out] res the ny dot products
+     */
+    void dotProductMultiDoubleCall(double *x, double *y, int size, int ny, size_t y_stride, double *res);
+
 #if defined(BINARY32) || defined(__NOAVX__)
     void setDotProductAVX() {}
     void setDotProductFMA() {}
@@ -626,6 +662,21 @@ public:
     template<class VectorClass>
     int computeParsimonyBranchFastSIMD(PhyloNeighbor *dad_branch, PhyloNode *dad, int *branch_subst = NULL);
 
+    typedef int (PhyloTree::*ComputeParsimonyInsertionType)(UINT *, UINT *, UINT *);
+    ComputeParsimonyInsertionType computeParsimonyInsertionPointer;
+
+    /**
+            compute the parsimony score of the tree after inserting a taxon on a branch,
+            without touching the tree, so that all branches can be evaluated in parallel
+            @param dad_pars partial parsimony of one side of the branch
+            @param node_pars partial parsimony of the other side of the branch
+            @param taxon_pars partial parsimony of the inserted taxon
+            @return parsimony score of the tree after insertion
+     */
+    int computeParsimonyInsertionFast(UINT *dad_pars, UINT *node_pars, UINT *taxon_pars);
+    template<class VectorClass>
+    int computeParsimonyInsertionFastSIMD(UINT *dad_pars, UINT *node_pars, UINT *taxon_pars);
+
 
 //    void printParsimonyStates(PhyloNeighbor *dad_branch = NULL, PhyloNode *dad = NULL);
 
@@ -638,11 +689,19 @@ public:
 
     virtual void setParsimonyKernelSSE();
 
+#ifdef INCLUDE_AVX512
+    virtual void setParsimonyKernelAVX512();
+#endif
+
     /****************************************************************************
             likelihood function
      ****************************************************************************/
 
-    size_t getBufferPartialLhSize();
+    /**
+        @param ncat_mix number of rate categories times mixture classes, 0 to take it from the current model
+        @return number of doubles of buffer_partial_lh
+    */
+    size_t getBufferPartialLhSize(size_t ncat_mix = 0);
 
     /**
             initialize partial_lh vector of all PhyloNeighbors, allocating central_partial_lh
@@ -669,6 +728,16 @@ public:
      */
     virtual void clearAllPartialLH(bool make_null = false);
 
+    /**
+            add the number of hits and misses of the tip partial likelihood cache
+            @param hits[in,out] number of hits
+            @param misses[in,out] number of misses
+     */
+    virtual void getPartialInfoCacheStats(uint64_t &hits, uint64_t &misses) {
+        hits += partial_info_cache.hits;
+        misses += partial_info_cache.misses;
+    }
+
     /**
      * compute all partial likelihoods if not computed before
      */
@@ -913,6 +982,19 @@ public:
      */
     virtual double computePatternLhCat(SiteLoglType wsl);
 
+    /**
+     * E-step of the EM algorithm for category weights (Wang et al. 2008), a reduction
+     * over patterns done in parallel, the category loops are kept plain for vectorization
+     * @param lh_cat likelihoods of every pattern and category (nptn x ncat)
+     * @param ncat number of categories
+     * @param weight weights to multiply lh_cat with, NULL if lh_cat is already weighted
+     * @param invar_weight factor to multiply ptn_invar with
+     * @param[out] new_weight updated weights, i.e. the posterior probabilities of every category summed over all sites, divided by the number of sites
+     * @param post if not NULL, store pattern frequency times posterior probabilities of every pattern and category, can be lh_cat
+     * @return log-likelihood of lh_cat under the weights
+     */
+    double computeEMWeights(double *lh_cat, size_t ncat, double *weight, double invar_weight, double *new_weight, double *post = NULL);
+
     /**
         compute state frequency for each pattern (for Huaichun)
         @param[out] ptn_state_freq state frequency vector per pattern, 
@@ -1155,6 +1237,22 @@ public:
      */
     void computeLikelihoodDerv(PhyloNeighbor *dad_branch, PhyloNode *dad, double &df, double &ddf);
 
+    /**
+            compute the derivatives of the tree log-likelihood with respect to the entries of the
+            rate matrix of a reversible model, from the partial likelihoods of both ends of every branch
+            @param dlnl_dq (OUT) num_states x num_states derivatives, row-major
+            @return FALSE if not supported for the current model, rate heterogeneity or kernel
+     */
+    bool computeQMatrixGradient(double *dlnl_dq);
+
+    /**
+            add the contributions of all branches of a subtree to the eigen-space gradient matrix
+            @param node the current node
+            @param dad dad of the node, used to direct the search
+            @param sum_mat (IN/OUT) gradient matrix in eigen space
+     */
+    void computeQMatrixGradient(PhyloNode *node, PhyloNode *dad, double *sum_mat);
+
     typedef void (PhyloTree::*ComputeLikelihoodDervType)(PhyloNeighbor *, PhyloNode *, double &, double &);
     ComputeLikelihoodDervType computeLikelihoodDervPointer;
 
@@ -1362,6 +1460,46 @@ public:
      */
     virtual void doNNI(NNIMove &move, bool clearLH = true);
 
+    /**
+            compute the topology hash of the tree from scratch. Every taxon has a fixed random key,
+            every split is keyed by the XOR of the keys of its taxa and the tree hash is the sum
+            of the mixed keys of all internal splits. doNNI() updates the hash in constant time,
+            other topological changes (readTreeString, SPR) invalidate it.
+            @return topology hash of the current tree
+     */
+    uint64_t computeTopologyHash();
+
+    /**
+            @return topology hash of the current tree, recomputed if it is no longer valid
+     */
+    uint64_t getTopologyHash() {
+        if (!topo_hash_valid)
+            return computeTopologyHash();
+        return topo_hash;
+    }
+
+    /**
+            compute the log-likelihood of the current tree with its branch lengths kept fixed.
+            Partial likelihoods of clades with the same subtree topology and branch lengths as in
+            a previously evaluated tree are copied from the clade cache instead of recomputed;
+            the newly computed ones are added to the cache as long as it stays below max_bytes.
+            The cache is only valid for one model, call clearCladeCache() before changing it.
+            @param max_bytes memory limit of the clade cache
+            @return tree log-likelihood
+     */
+    double computeLikelihoodCladeCache(size_t max_bytes);
+
+    /**
+            release all partial likelihoods of the clade cache
+     */
+    void clearCladeCache();
+
+    /** number of clades taken from the clade cache */
+    int64_t clade_cache_hits;
+
+    /** number of clades computed while the clade cache was in use */
+    int64_t clade_cache_misses;
+
     /**
      * [DEPRECATED]
      * Randomly choose perform an NNI, out of the two defined by branch node1-node2.
@@ -1865,6 +2003,12 @@ protected:
     /** distance (# of branches) between 2 nodes */
     int *nodeBranchDists;
 
+    /** RELL replicates shared by all branches in testAllBranches() */
+    BootWeights *branch_test_samples;
+
+    /** RELL scores of the tested tree for branch_test_samples */
+    DoubleVector branch_test_rell;
+
     /**
      * A list containing all the marked list. This is used in the dynamic programming
      * algorithm for compute inter subtree distances
@@ -1929,6 +2073,60 @@ protected:
      */
     int spr_radius;
 
+    /**
+            topology hash of the current tree, see computeTopologyHash()
+     */
+    uint64_t topo_hash;
+
+    /**
+            true if topo_hash reflects the current topology
+     */
+    bool topo_hash_valid;
+
+    /**
+            XOR of the keys of all taxa, to get the key of the complement of a subtree
+     */
+    uint64_t topo_key_all;
+
+    /**
+            compute topo_key of all neighbors in the subtree rooted at node
+            @return XOR of the keys of all taxa in the subtree
+     */
+    uint64_t computeTopoKeys(PhyloNode *node, PhyloNode *dad);
+
+    /**
+            set topo_key of the neighbors pointing towards dad and add all internal splits
+            of the subtree rooted at node to topo_hash
+     */
+    void sumTopoHash(PhyloNode *node, PhyloNode *dad);
+
+    /**
+            @return contribution of a split with subtree key \a key to the topology hash
+     */
+    uint64_t splitTopoHash(uint64_t key);
+
+    /** partial likelihoods of clades of previously evaluated trees, by CladeKey::hash */
+    CladePartialLhMap clade_cache;
+
+    /** memory used by clade_cache */
+    size_t clade_cache_bytes;
+
+    /**
+            compute the clade keys of the subtree rooted at node, indexed by node ID
+     */
+    void computeCladeKeys(PhyloNode *node, PhyloNode *dad, vector<CladeKey> &keys);
+
+    /**
+            copy the cached partial likelihoods into the subtree rooted at node, top down,
+            stopping at clades found in the cache
+     */
+    void restoreCladePartialLh(PhyloNode *node, PhyloNode *dad, vector<CladeKey> &keys);
+
+    /**
+            add the computed partial likelihoods of the subtree rooted at node to the cache
+     */
+    void storeCladePartialLh(PhyloNode *node, PhyloNode *dad, vector<CladeKey> &keys, size_t max_bytes);
+
 
     /**
             the main memory storing all partial likelihoods for all neighbors of the tree.
@@ -1960,6 +2158,9 @@ protected:
     /** mapping from */
     MemSlotVector mem_slots;
 
+    /** cache of the tip partial likelihoods precomputed by computePartialInfo() */
+    PartialInfoCache partial_info_cache;
+
     /**
             TRUE to discard saturated for Meyer & von Haeseler (2003) model
      */
@@ -1994,6 +2195,7 @@ protected:
      ****************************************************************************/
 
     /**
+            the patterns must have been ordered by Alignment::orderPatternByNumChars()
             @return size of the bits block vector for one node
      */
     size_t getBitsBlockSize();
@@ -25,6 +25,7 @@
 void PhyloTree::setParsimonyKernelAVX() {
 	computeParsimonyBranchPointer = &PhyloTree::computeParsimonyBranchFastSIMD<Vec8ui>;
     computePartialParsimonyPointer = &PhyloTree::computePartialParsimonyFastSIMD<Vec8ui>;
+    computeParsimonyInsertionPointer = &PhyloTree::computeParsimonyInsertionFastSIMD<Vec8ui>;
 }
 
 void PhyloTree::setDotProductAVX() {
@@ -34,6 +35,7 @@ void PhyloTree::setDotProductAVX() {
 		dotProduct = &PhyloTree::dotProductSIMD<double, Vec4d>;
 #endif
         dotProductDouble = &PhyloTree::dotProductSIMD<double, Vec4d>;
+        dotProductMultiDouble = &PhyloTree::dotProductMultiSIMD<double, Vec4d>;
 }
 
 void PhyloTree::setLikelihoodKernelAVX() {
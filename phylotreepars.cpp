@@ -49,11 +49,11 @@ void PhyloTree::computePartialParsimonyFast(PhyloNeighbor *dad_branch, PhyloNode
     if (node->isLeaf() && dad) {
         // external node
         int leafid = node->id;
-        memset(dad_branch->partial_pars, 0, getBitsBlockSize()*sizeof(UINT));
-        int max_sites = ((aln->num_informative_sites+UINT_BITS-1)/UINT_BITS)*UINT_BITS;
-        int ambi_aa[] = {2, 3, 5, 6, 9, 10}; // {4+8, 32+64, 512+1024};
         if (aln->ordered_pattern.empty())
             aln->orderPatternByNumChars();
+        memset(dad_branch->partial_pars, 0, getBitsBlockSize()*sizeof(UINT));
+        int max_sites = ((aln->num_parsimony_sites+UINT_BITS-1)/UINT_BITS)*UINT_BITS;
+        int ambi_aa[] = {2, 3, 5, 6, 9, 10}; // {4+8, 32+64, 512+1024};
         int start_pos = 0;
         for (vector<Alignment*>::iterator alnit = partitions->begin(); alnit != partitions->end(); alnit++) {
             int end_pos = start_pos + (*alnit)->ordered_pattern.size();
@@ -88,7 +88,7 @@ void PhyloTree::computePartialParsimonyFast(PhyloNeighbor *dad_branch, PhyloNode
                         }
                     }
                 }
-                //assert(site == aln->num_informative_sites);
+                //assert(site == aln->num_parsimony_sites);
                 // add dummy states
                 //if (site < max_sites)
                 //    dad_branch->partial_pars[(site/UINT_BITS)*4] |= ~((1<<(site%UINT_BITS)) - 1);
@@ -120,7 +120,7 @@ void PhyloTree::computePartialParsimonyFast(PhyloNeighbor *dad_branch, PhyloNode
                         }
                     }
                 }
-                //assert(site == aln->num_informative_sites);
+                //assert(site == aln->num_parsimony_sites);
                 // add dummy states
                 //if (site < max_sites)
                 //    dad_branch->partial_pars[(site/UINT_BITS)*20] |= ~((1<<(site%UINT_BITS)) - 1);
@@ -151,7 +151,7 @@ void PhyloTree::computePartialParsimonyFast(PhyloNeighbor *dad_branch, PhyloNode
             start_pos = end_pos;
         } // FOR LOOP
 
-        assert(site == aln->num_informative_sites);
+        assert(site == aln->num_parsimony_sites);
         // add dummy states
         if (site < max_sites)
             dad_branch->partial_pars[(site/UINT_BITS)*nstates] |= ~((1<<(site%UINT_BITS)) - 1);
@@ -168,8 +168,9 @@ void PhyloTree::computePartialParsimonyFast(PhyloNeighbor *dad_branch, PhyloNode
         }
 //        UINT score = left->partial_pars[0] + right->partial_pars[0];
         UINT score = 0;
-        int nsites = aln->num_informative_sites;
+        int nsites = aln->num_parsimony_sites;
         nsites = (nsites+UINT_BITS-1)/UINT_BITS;
+        UINT *site_weight = aln->pars_site_weight.data();
 
         switch (nstates) {
         case 4:
@@ -188,7 +189,7 @@ void PhyloTree::computePartialParsimonyFast(PhyloNeighbor *dad_branch, PhyloNode
 				z[3] = x[3] & y[3];
 				w = z[0] | z[1] | z[2] | z[3];
 				w = ~w;
-				score += __builtin_popcount(w);
+				score += vml_popcnt(w) * site_weight[site];
 				z[0] |= w & (x[0] | y[0]);
 				z[1] |= w & (x[1] | y[1]);
 				z[2] |= w & (x[2] | y[2]);
@@ -212,7 +213,7 @@ void PhyloTree::computePartialParsimonyFast(PhyloNeighbor *dad_branch, PhyloNode
 					w |= z[i];
 				}
 				w = ~w;
-				score += vml_popcnt(w);
+				score += vml_popcnt(w) * site_weight[site];
 				for (i = 0; i < nstates; i++) {
 					z[i] |= w & (x[i] | y[i]);
 				}
@@ -239,10 +240,11 @@ int PhyloTree::computeParsimonyBranchFast(PhyloNeighbor *dad_branch, PhyloNode *
     if ((node_branch->partial_lh_computed & 2) == 0)
         computePartialParsimonyFast(node_branch, node);
     int site;
-    int nsites = (aln->num_informative_sites + UINT_BITS-1) / UINT_BITS;
+    int nsites = (aln->num_parsimony_sites + UINT_BITS-1) / UINT_BITS;
+    UINT *site_weight = aln->pars_site_weight.data();
     int nstates = aln->getMaxNumStates();
 
-    int scoreid = ((aln->num_informative_sites+UINT_BITS-1)/UINT_BITS)*nstates;
+    int scoreid = ((aln->num_parsimony_sites+UINT_BITS-1)/UINT_BITS)*nstates;
     UINT sum_end_node = (dad_branch->partial_pars[scoreid] + node_branch->partial_pars[scoreid]);
     UINT score = sum_end_node;
 
@@ -259,7 +261,7 @@ int PhyloTree::computeParsimonyBranchFast(PhyloNeighbor *dad_branch, PhyloNode *
             UINT *y = node_branch->partial_pars + offset;
 			UINT w = (x[0] & y[0]) | (x[1] & y[1]) | (x[2] & y[2]) | (x[3] & y[3]);
 			w = ~w;
-			score += vml_popcnt(w);
+			score += vml_popcnt(w) * site_weight[site];
 //            #ifndef _OPENMP
 //            if (score >= lower_bound)
 //                break;
@@ -280,7 +282,7 @@ int PhyloTree::computeParsimonyBranchFast(PhyloNeighbor *dad_branch, PhyloNode *
 				w |= x[i] & y[i];
 			}
 			w = ~w;
-			score += vml_popcnt(w);
+			score += vml_popcnt(w) * site_weight[site];
 //            #ifndef _OPENMP
 //            if (score >= lower_bound)
 //                break;
@@ -294,6 +296,59 @@ int PhyloTree::computeParsimonyBranchFast(PhyloNeighbor *dad_branch, PhyloNode *
     return score;
 }
 
+int PhyloTree::computeParsimonyInsertionFast(UINT *dad_pars, UINT *node_pars, UINT *taxon_pars) {
+    int site;
+    int nsites = (aln->num_parsimony_sites + UINT_BITS-1) / UINT_BITS;
+    UINT *site_weight = aln->pars_site_weight.data();
+    int nstates = aln->getMaxNumStates();
+
+    int scoreid = nsites*nstates;
+    UINT score = dad_pars[scoreid] + node_pars[scoreid] + taxon_pars[scoreid];
+
+    // the new internal node is computed on the fly and never stored
+    switch (nstates) {
+    case 4:
+		for (site = 0; site < nsites; site++) {
+            size_t offset = 4*site;
+            UINT *x = dad_pars + offset;
+            UINT *y = node_pars + offset;
+            UINT *t = taxon_pars + offset;
+            UINT z0 = x[0] & y[0], z1 = x[1] & y[1], z2 = x[2] & y[2], z3 = x[3] & y[3];
+			UINT w = ~(z0 | z1 | z2 | z3);
+			score += vml_popcnt(w) * site_weight[site];
+            z0 |= w & (x[0] | y[0]);
+            z1 |= w & (x[1] | y[1]);
+            z2 |= w & (x[2] | y[2]);
+            z3 |= w & (x[3] | y[3]);
+            w = ~((z0 & t[0]) | (z1 & t[1]) | (z2 & t[2]) | (z3 & t[3]));
+			score += vml_popcnt(w) * site_weight[site];
+		}
+		break;
+    default:
+		for (site = 0; site < nsites; site++) {
+            size_t offset = nstates*site;
+            UINT *x = dad_pars + offset;
+            UINT *y = node_pars + offset;
+            UINT *t = taxon_pars + offset;
+			int i;
+			UINT w = x[0] & y[0];
+			for (i = 1; i < nstates; i++) {
+				w |= x[i] & y[i];
+			}
+			w = ~w;
+			score += vml_popcnt(w) * site_weight[site];
+            UINT wt = 0;
+			for (i = 0; i < nstates; i++) {
+                wt |= ((x[i] & y[i]) | (w & (x[i] | y[i]))) & t[i];
+			}
+			wt = ~wt;
+			score += vml_popcnt(wt) * site_weight[site];
+		}
+		break;
+    }
+    return score;
+}
+
 void PhyloTree::computeAllPartialPars(PhyloNode *node, PhyloNode *dad) {
 	if (!node) node = (PhyloNode*)root;
 	FOR_NEIGHBOR_IT(node, dad, it) {
@@ -417,6 +472,38 @@ int PhyloTree::computeParsimonyTree(const char *out_prefix, Alignment *alignment
         added_node->addNeighbor((Node*) 1, -1.0);
         added_node->addNeighbor((Node*) 2, -1.0);
 
+        if (constraintTree.empty()) {
+            // compute partial parsimony of both sides of every branch first,
+            // then score all insertion points independently of each other
+            PhyloNeighbor *taxon_nei = (PhyloNeighbor*) added_node->findNeighbor(new_taxon);
+            computePartialParsimony(taxon_nei, added_node);
+            int nbranches = nodes1.size();
+            vector<UINT*> node_pars(nbranches), dad_pars(nbranches);
+            for (int nodeid = 0; nodeid < nbranches; nodeid++) {
+                PhyloNeighbor *node_nei = (PhyloNeighbor*) nodes2[nodeid]->findNeighbor(nodes1[nodeid]);
+                PhyloNeighbor *dad_nei = (PhyloNeighbor*) nodes1[nodeid]->findNeighbor(nodes2[nodeid]);
+                computePartialParsimony(node_nei, (PhyloNode*)nodes2[nodeid]);
+                computePartialParsimony(dad_nei, (PhyloNode*)nodes1[nodeid]);
+                node_pars[nodeid] = node_nei->partial_pars;
+                dad_pars[nodeid] = dad_nei->partial_pars;
+            }
+            IntVector scores(nbranches);
+            #ifdef _OPENMP
+            #pragma omp parallel for schedule(static) if(nbranches > 16)
+            #endif
+            for (int nodeid = 0; nodeid < nbranches; nodeid++)
+                scores[nodeid] = (this->*computeParsimonyInsertionPointer)(dad_pars[nodeid], node_pars[nodeid], taxon_nei->partial_pars);
+            // take the first best branch, as the sequential search would do
+            int best_id = 0;
+            for (int nodeid = 1; nodeid < nbranches; nodeid++)
+                if (scores[nodeid] < scores[best_id])
+                    best_id = nodeid;
+            target_node = (PhyloNode*)nodes1[best_id];
+            target_dad = (PhyloNode*)nodes2[best_id];
+            best_pars_score = addTaxonMPFast(new_taxon, added_node, target_node, target_dad);
+            assert(best_pars_score == scores[best_id]);
+            memcpy(new_taxon_partial_pars, tmp_partial_pars, pars_block_size*sizeof(UINT));
+        } else
         for (int nodeid = 0; nodeid < nodes1.size(); nodeid++) {
         
             int score = addTaxonMPFast(new_taxon, added_node, nodes1[nodeid], nodes2[nodeid]);
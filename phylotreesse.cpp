@@ -45,8 +45,15 @@ void PhyloTree::setParsimonyKernel(LikelihoodKernel lk) {
     if (lk == LK_EIGEN || instruction_set < 2) {
         computeParsimonyBranchPointer = &PhyloTree::computeParsimonyBranchFast;
         computePartialParsimonyPointer = &PhyloTree::computePartialParsimonyFast;
+        computeParsimonyInsertionPointer = &PhyloTree::computeParsimonyInsertionFast;
     	return;
     }
+#ifdef INCLUDE_AVX512
+    if (instruction_set >= 9) {
+        setParsimonyKernelAVX512();
+        return;
+    }
+#endif
     if (instruction_set >= 7) {
         setParsimonyKernelAVX();
         return;
@@ -86,6 +93,7 @@ void PhyloTree::setLikelihoodKernel(LikelihoodKernel lk, int num_threads) {
 		dotProduct = &PhyloTree::dotProductSIMD<double, Vec1d>;
 #endif
         dotProductDouble = &PhyloTree::dotProductSIMD<double, Vec1d>;
+        dotProductMultiDouble = &PhyloTree::dotProductMultiSIMD<double, Vec1d>;
 #endif
 	}
 
@@ -175,6 +183,148 @@ void PhyloTree::computeLikelihoodDerv(PhyloNeighbor *dad_branch, PhyloNode *dad,
 	(this->*computeLikelihoodDervPointer)(dad_branch, dad, df, ddf);
 }
 
+bool PhyloTree::computeQMatrixGradient(double *dlnl_dq) {
+    // partial_lh layout and scaling are those of the SIMD kernels
+    if (vector_size <= 1 || model->isSiteSpecificModel() || !model->isReversible() || model->getNMixtures() != 1 ||
+        !model_factory->unobserved_ptns.empty() || !model->getEigenvalues())
+        return false;
+
+    size_t nstates = aln->num_states;
+    size_t ncat = site_rate->getNRate();
+    size_t i, j, k;
+    double *sum_mat = new double[nstates*nstates];
+    memset(sum_mat, 0, sizeof(double)*nstates*nstates);
+
+    computeQMatrixGradient((PhyloNode*)root, NULL, sum_mat);
+
+    // dlnL/dQ = U^-T * sum_mat * U^T
+    double *evec = model->getEigenvectors();
+    double *inv_evec = model->getInverseEigenvectors();
+    double *tmp = new double[nstates*nstates];
+    for (i = 0; i < nstates; i++)
+        for (j = 0; j < nstates; j++) {
+            double sum = 0.0;
+            for (k = 0; k < nstates; k++)
+                sum += sum_mat[i*nstates+k] * evec[j*nstates+k];
+            tmp[i*nstates+j] = sum;
+        }
+    for (i = 0; i < nstates; i++)
+        for (j = 0; j < nstates; j++) {
+            double sum = 0.0;
+            for (k = 0; k < nstates; k++)
+                sum += inv_evec[k*nstates+i] * tmp[k*nstates+j];
+            dlnl_dq[i*nstates+j] = sum;
+        }
+    delete [] tmp;
+    delete [] sum_mat;
+    return true;
+}
+
+void PhyloTree::computeQMatrixGradient(PhyloNode *node, PhyloNode *dad, double *sum_mat) {
+    FOR_NEIGHBOR_IT(node, dad, it)
+        computeQMatrixGradient((PhyloNode*)(*it)->node, node, sum_mat);
+    if (!dad)
+        return;
+
+    PhyloNeighbor *dad_branch = (PhyloNeighbor*)dad->findNeighbor(node);
+    PhyloNeighbor *node_branch = (PhyloNeighbor*)node->findNeighbor(dad);
+    // computes the partial likelihoods of both ends and _pattern_lh
+    computeLikelihoodBranch(dad_branch, dad);
+
+    size_t nstates = aln->num_states;
+    size_t ncat = site_rate->getNRate();
+    size_t block = ncat*nstates;
+    size_t nsq = nstates*nstates;
+    size_t nptn = aln->size();
+    size_t i, j, c;
+    bool safe_numeric = params->lk_safe_scaling || leafNum >= params->numseq_safe_scaling;
+    PhyloNeighbor *ends[2] = {dad_branch, node_branch};
+
+    // sum over patterns of the eigen-space partial likelihoods of both ends, per category
+    double *cat_mat = new double[ncat*nsq];
+    memset(cat_mat, 0, sizeof(double)*ncat*nsq);
+    double *cat_prop = new double[ncat];
+    for (c = 0; c < ncat; c++)
+        cat_prop[c] = site_rate->getProp(c);
+
+#ifdef _OPENMP
+#pragma omp parallel num_threads(num_threads) private(i, j, c)
+#endif
+    {
+        double *thread_mat = new double[ncat*nsq];
+        memset(thread_mat, 0, sizeof(double)*ncat*nsq);
+        double *buffer = new double[2*nstates];
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+        for (size_t ptn = 0; ptn < nptn; ptn++) {
+            if (ptn_freq[ptn] == 0.0)
+                continue;
+            size_t ptn_addr = (ptn/vector_size)*vector_size*block + ptn%vector_size;
+            double *vec[2];
+            for (int e = 0; e < 2; e++)
+                vec[e] = (ends[e]->node->isLeaf()) ? tip_partial_lh + (aln->at(ptn))[ends[e]->node->id]*nstates : NULL;
+            // the scaling is mostly the same for all categories, exp() only when it changes
+            int last_scale = -1;
+            double ptn_coeff = 0.0;
+            for (c = 0; c < ncat; c++) {
+                int scale = 0;
+                for (int e = 0; e < 2; e++) {
+                    if (ends[e]->node->isLeaf())
+                        continue;
+                    double *partial_lh = ends[e]->partial_lh + ptn_addr + c*nstates*vector_size;
+                    vec[e] = buffer + e*nstates;
+                    for (i = 0; i < nstates; i++)
+                        vec[e][i] = partial_lh[i*vector_size];
+                    scale += safe_numeric ? ends[e]->scale_num[ptn*ncat+c] : ends[e]->scale_num[ptn];
+                }
+                if (scale != last_scale) {
+                    ptn_coeff = ptn_freq[ptn] * exp(scale*LOG_SCALING_THRESHOLD - _pattern_lh[ptn]);
+                    last_scale = scale;
+                }
+                double coeff = ptn_coeff * cat_prop[c];
+                if (coeff == 0.0)
+                    continue;
+                double *mat = thread_mat + c*nsq;
+                double *vec_right = vec[1];
+                for (i = 0; i < nstates; i++) {
+                    double vi = coeff * vec[0][i];
+                    double *mat_row = mat + i*nstates;
+                    for (j = 0; j < nstates; j++)
+                        mat_row[j] += vi * vec_right[j];
+                }
+            }
+        }
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+        for (i = 0; i < ncat*nsq; i++)
+            cat_mat[i] += thread_mat[i];
+        delete [] buffer;
+        delete [] thread_mat;
+    }
+    delete [] cat_prop;
+
+    // multiply with the derivative of exp(Q*len) in eigen space:
+    // (exp(eval_i*len) - exp(eval_j*len)) / (eval_i - eval_j), or len*exp(eval_i*len) if equal
+    double *eval = model->getEigenvalues();
+    for (c = 0; c < ncat; c++) {
+        double len = site_rate->getRate(c) * dad_branch->length;
+        double *mat = cat_mat + c*nsq;
+        for (i = 0; i < nstates; i++)
+            for (j = 0; j < nstates; j++) {
+                double diff = eval[i] - eval[j];
+                double fij;
+                if (diff == 0.0)
+                    fij = len * exp(eval[i]*len);
+                else
+                    fij = exp(eval[j]*len) * expm1(diff*len) / diff;
+                sum_mat[i*nstates+j] += mat[i*nstates+j] * fij;
+            }
+    }
+    delete [] cat_mat;
+}
+
 
 double PhyloTree::computeLikelihoodFromBuffer() {
 	assert(current_it && current_it_back);
@@ -190,6 +340,10 @@ double PhyloTree::dotProductDoubleCall(double *x, double *y, int size) {
     return (this->*dotProductDouble)(x, y, size);
 }
 
+void PhyloTree::dotProductMultiDoubleCall(double *x, double *y, int size, int ny, size_t y_stride, double *res) {
+    (this->*dotProductMultiDouble)(x, y, size, ny, y_stride, res);
+}
+
 
 
 void PhyloTree::computeTipPartialLikelihood() {
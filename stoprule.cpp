@@ -37,6 +37,9 @@ StopRule::StopRule() : CheckpointFactory()
 	max_run_time = -1.0;
 	curIteration = 0;
     should_stop = false;
+    budget_iteration = -1;
+    budget_time = 0.0;
+    iteration_time = 0.0;
 }
 
 void StopRule::initialize(Params &params) {
@@ -111,9 +114,55 @@ void StopRule::restoreCheckpoint() {
 //	}
 //}
 
+double getRemainingTimeBudget(double fraction) {
+    Params &params = Params::getInstance();
+    if (params.time_budget <= 0)
+        return DBL_MAX;
+    return params.analysis_budget_start + fraction * params.analysis_budget - getRealTime();
+}
+
+void startAnalysisBudget(int num_analyses) {
+    Params &params = Params::getInstance();
+    if (params.time_budget <= 0)
+        return;
+    params.analysis_budget_start = getRealTime();
+    params.analysis_budget = max(params.time_budget_start + params.time_budget - params.analysis_budget_start, 0.0) / num_analyses;
+}
+
+bool StopRule::meetDeadline(int cur_iteration) {
+    if (Params::getInstance().time_budget <= 0)
+        return false;
+    double now = getRealTime();
+    if (budget_iteration >= 0 && cur_iteration > budget_iteration) {
+        // slow iterations raise the estimate at once, fast ones only let it decay
+        double last_time = (now - budget_time) / (cur_iteration - budget_iteration);
+        iteration_time = max(last_time, 0.5 * (iteration_time + last_time));
+    }
+    if (cur_iteration != budget_iteration) {
+        budget_iteration = cur_iteration;
+        budget_time = now;
+    }
+    return getRemainingTimeBudget(BUDGET_TREE_SEARCH) < iteration_time;
+}
+
+double StopRule::getBudgetIterations() {
+    double remaining = getRemainingTimeBudget(BUDGET_TREE_SEARCH);
+    if (remaining == DBL_MAX || iteration_time <= 0)
+        return DBL_MAX;
+    return max(remaining, 0.0) / iteration_time;
+}
+
+bool StopRule::isOutOfTime() {
+    if (stop_condition == SC_REAL_TIME && getRealTime() - start_real_time >= max_run_time)
+        return true;
+    return Params::getInstance().time_budget > 0 && getRemainingTimeBudget(BUDGET_TREE_SEARCH) < iteration_time;
+}
+
 bool StopRule::meetStopCondition(int cur_iteration, double cur_correlation) {
     if (should_stop)
         return true;
+    if (meetDeadline(cur_iteration))
+        return true;
 	switch (stop_condition) {
 		case SC_FIXED_ITERATION:
 			return cur_iteration >= min_iteration;
@@ -154,7 +203,7 @@ double StopRule::getRemainingTime(int cur_iteration) {
 //			niterations = getLastImprovedIteration() + unsuccess_iteration;
 		break;
 	}
-	return (niterations - cur_iteration) * realtime_secs / (cur_iteration - 1);
+	return min((niterations - cur_iteration) * realtime_secs / (cur_iteration - 1), getRemainingTimeBudget(BUDGET_TREE_SEARCH));
 }
 
 //void StopRule::setStopCondition(STOP_CONDITION sc) {
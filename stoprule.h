@@ -23,6 +23,29 @@
 #include "tools.h"
 #include "checkpoint.h"
 
+/**
+    fractions of the -deadline time budget of an analysis by which each phase has to be finished,
+    the rest is reserved for the final model optimization and the output
+*/
+const double BUDGET_MODEL_SELECTION = 0.25;
+const double BUDGET_INITIAL_TREES = 0.4;
+const double BUDGET_TREE_SEARCH = 0.85;
+
+/** number of iterations left in the budget when the search starts to intensify */
+const int BUDGET_ENDGAME_ITERATIONS = 20;
+
+/**
+    @param fraction fraction of the -deadline time budget of the current analysis
+    @return seconds left until this fraction of the budget is used up, DBL_MAX if there is no deadline
+*/
+double getRemainingTimeBudget(double fraction);
+
+/**
+    give the next analysis its share of the rest of the -deadline time budget
+    @param num_analyses number of analyses still to run, including the next one
+*/
+void startAnalysisBudget(int num_analyses);
+
 /**
 Stopping rule
 	@author BUI Quang Minh <minh.bui@univie.ac.at>
@@ -114,6 +137,22 @@ public:
         should_stop = true;
     }
 
+    /**
+        @param cur_iteration current iteration number
+        @return TRUE if the next iteration would not finish within the -deadline search budget
+    */
+    bool meetDeadline(int cur_iteration);
+
+    /**
+        @return estimated number of iterations that still fit into the -deadline search budget
+    */
+    double getBudgetIterations();
+
+    /**
+        @return TRUE if the search ran out of time, either the -maxtime limit or the -deadline search budget
+    */
+    bool isOutOfTime();
+
 private:
 
     /**
@@ -166,6 +205,13 @@ private:
     /** TRUE to override stop condition */
     bool should_stop;
 
+    /** iteration and real time of the last deadline check */
+    int budget_iteration;
+    double budget_time;
+
+    /** conservative estimate of the wall-clock time of one iteration */
+    double iteration_time;
+
 	/* FOLLOWING CODES ARE FROM IQPNNI version 3 */	
 
 //	int nTime_;
@@ -0,0 +1,375 @@
+/*
+ * streamsplitset.cpp
+ *
+ *  Split frequencies of large tree files from 128-bit split fingerprints
+ */
+
+#include "streamsplitset.h"
+#include "mtreeset.h"
+
+/** splitmix64 finalizer, derives the taxon keys */
+static inline uint64_t mixSplitKey(uint64_t x) {
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+TreeStream::TreeStream() {
+	all_key.lo = all_key.hi = 0;
+	is_rooted = false;
+}
+
+void TreeStream::assignTaxonIDs(MTree *tree) {
+	NodeVector taxa;
+	tree->getTaxa(taxa);
+	sort(taxa.begin(), taxa.end(), nodenamecmp);
+
+	if (taxname.empty()) {
+		// the first tree defines the taxa
+		for (NodeVector::iterator it = taxa.begin(); it != taxa.end(); it++)
+			taxname.push_back((*it)->name);
+		taxon_keys.resize(taxname.size());
+		for (size_t i = 0; i < taxname.size(); i++) {
+			taxon_keys[i].lo = mixSplitKey((2*i + 1) * 0x9e3779b97f4a7c15ULL);
+			taxon_keys[i].hi = mixSplitKey((2*i + 2) * 0x9e3779b97f4a7c15ULL);
+			all_key ^= taxon_keys[i];
+		}
+	}
+	if (taxa.size() != taxname.size())
+		outError("Tree has different number of taxa!");
+	int i = 0;
+	for (NodeVector::iterator it = taxa.begin(); it != taxa.end(); it++, i++) {
+		if ((*it)->name != taxname[i])
+			outError("Tree has different taxa names!");
+		(*it)->id = i;
+	}
+}
+
+StreamSplitSet::StreamSplitSet() {
+	out_sg = NULL;
+	remaining = 0;
+	ntrees = 0;
+}
+
+int StreamSplitSet::sumTreeWeights() {
+	if (tree_weights.empty())
+		return ntrees;
+	int sum = 0;
+	for (IntVector::iterator it = tree_weights.begin(); it != tree_weights.end(); it++)
+		sum += *it;
+	return sum;
+}
+
+int StreamSplitSet::find(const SplitFingerprint &fp) {
+	size_t mask = table_ids.size() - 1;
+	for (size_t slot = fp.lo & mask; table_ids[slot] >= 0; slot = (slot + 1) & mask)
+		if (table_keys[slot] == fp)
+			return table_ids[slot];
+	return -1;
+}
+
+int StreamSplitSet::findOrInsert(const SplitFingerprint &fp) {
+	// keep the load factor below 1/2
+	if (split_weights.size() * 2 >= table_ids.size()) {
+		vector<SplitFingerprint> old_keys;
+		IntVector old_ids;
+		old_keys.swap(table_keys);
+		old_ids.swap(table_ids);
+		size_t capacity = max(old_ids.size() * 2, (size_t)1024);
+		table_keys.resize(capacity);
+		table_ids.resize(capacity, -1);
+		for (size_t i = 0; i < old_ids.size(); i++)
+			if (old_ids[i] >= 0) {
+				size_t slot = old_keys[i].lo & (capacity - 1);
+				while (table_ids[slot] >= 0)
+					slot = (slot + 1) & (capacity - 1);
+				table_keys[slot] = old_keys[i];
+				table_ids[slot] = old_ids[i];
+			}
+	}
+	size_t mask = table_ids.size() - 1;
+	size_t slot;
+	for (slot = fp.lo & mask; table_ids[slot] >= 0; slot = (slot + 1) & mask)
+		if (table_keys[slot] == fp)
+			return table_ids[slot];
+	table_keys[slot] = fp;
+	table_ids[slot] = split_weights.size();
+	split_weights.push_back(0.0);
+	return table_ids[slot];
+}
+
+SplitFingerprint StreamSplitSet::traverseSplits(MTree *tree, int weight, int pass, int &ntaxa,
+		bool &has_first, Node *node, Node *dad) {
+	SplitFingerprint fp = {0, 0};
+	ntaxa = 0;
+	has_first = false;
+	bool has_child = false;
+	int nall = taxname.size();
+	FOR_NEIGHBOR_IT(node, dad, it) {
+		int child_ntaxa;
+		bool child_first;
+		SplitFingerprint child_fp = traverseSplits(tree, weight, pass, child_ntaxa, child_first, (*it)->node, node);
+		fp ^= child_fp;
+		ntaxa += child_ntaxa;
+		has_first |= child_first;
+		has_child = true;
+		// ignore nodes with degree of 2, same as MTree::convertSplits()
+		if (node->degree() == 2)
+			continue;
+		// same orientation as Split::shouldInvert()
+		if (child_ntaxa * 2 > nall || (child_ntaxa * 2 == nall && !child_first))
+			child_fp ^= all_key;
+		if (pass == 1) {
+			split_weights[findOrInsert(child_fp)] += weight;
+			continue;
+		}
+		int id = find(child_fp);
+		ASSERT(id >= 0);
+		if (split_pos[id] < 0 || (*out_sg)[split_pos[id]])
+			continue;
+		Split *sp = new Split(nall, split_weights[id]);
+		tree->getTaxa(*sp, (*it)->node, node);
+		if (sp->shouldInvert())
+			sp->invert();
+		(*out_sg)[split_pos[id]] = sp;
+		remaining--;
+	}
+	if (!has_child) {
+		fp = taxon_keys[node->id];
+		ntaxa = 1;
+		has_first = (node->id == 0);
+	}
+	return fp;
+}
+
+bool StreamSplitSet::processTree(MTree *tree, int tree_id, int pass) {
+	assignTaxonIDs(tree);
+	if (!tree_weights.empty() && tree_id >= tree_weights.size())
+		outError("Tree file and tree weight file have different number of entries");
+	int weight = tree_weights.empty() ? 1 : tree_weights[tree_id];
+	if (weight == 0)
+		return true;
+	int ntaxa;
+	bool has_first;
+	traverseSplits(tree, weight, pass, ntaxa, has_first, tree->root);
+	return pass == 1 || remaining > 0;
+}
+
+int TreeStream::scanTrees(const char *infile, int burnin, int max_count, int pass) {
+	if (pass == 1)
+		cout << "Reading tree(s) file " << infile << " ..." << endl;
+	int count = 0;
+	bool rooted = false;
+	try {
+		ifstream in;
+		in.exceptions(ios::failbit | ios::badbit);
+		in.open(infile);
+		if (burnin > 0) {
+			int cnt = 0;
+			while (cnt < burnin && !in.eof()) {
+				char ch;
+				in >> ch;
+				if (ch == ';') cnt++;
+			}
+			if (pass == 1)
+				cout << cnt << " beginning tree(s) discarded" << endl;
+			if (in.eof())
+				throw "Burnin value is too large.";
+		}
+		for (count = 0; !in.eof() && count < max_count; ) {
+			MTree tree;
+			bool myrooted = is_rooted;
+			tree.readTree(in, myrooted);
+			if (count == 0)
+				rooted = tree.rooted;
+			bool next = processTree(&tree, count, pass);
+			count++;
+			if (!next)
+				break;
+			char ch;
+			in.exceptions(ios::goodbit);
+			in >> ch;
+			if (in.eof()) break;
+			in.unget();
+			in.exceptions(ios::failbit | ios::badbit);
+		}
+		in.close();
+	} catch (ios::failure) {
+		outError(ERR_READ_INPUT, infile);
+	} catch (const char* str) {
+		outError(str);
+	}
+	if (pass == 1)
+		cout << count << (rooted ? " rooted" : " un-rooted") << " tree(s) loaded" << endl;
+	return count;
+}
+
+void StreamSplitSet::convertSplits(const char *infile, int burnin, int max_count, const char *tree_weight_file,
+		SplitGraph &sg, double split_threshold, double weight_threshold) {
+	if (tree_weight_file)
+		readIntVector(tree_weight_file, burnin, max_count, tree_weights);
+
+	ntrees = scanTrees(infile, burnin, max_count, 1);
+	if (!tree_weights.empty() && tree_weights.size() != ntrees)
+		outError("Tree file and tree weight file have different number of entries");
+	if (verbose_mode >= VB_MED)
+		cout << split_weights.size() << " distinct splits counted" << endl;
+
+	// discard splits exactly like MTreeSet::convertSplits() to reproduce its split order
+	IntVector order(split_weights.size());
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = i;
+	int discarded = 0;
+	for (size_t i = 0; i < order.size(); ) {
+		if (split_weights[order[i]] <= weight_threshold) {
+			discarded++;
+			order[i] = order.back();
+			order.pop_back();
+		} else i++;
+	}
+	if (discarded)
+		cout << discarded << " split(s) discarded because weight <= " << weight_threshold << endl;
+	int nsplits = order.size();
+	double threshold = split_threshold * ntrees;
+	for (size_t i = 0; i < order.size(); ) {
+		if (split_weights[order[i]] <= threshold) {
+			order[i] = order.back();
+			order.pop_back();
+		} else i++;
+	}
+	cout << nsplits - order.size() << " split(s) discarded because frequency <= " << split_threshold << endl;
+
+	sg.createBlocks();
+	for (vector<string>::iterator it = taxname.begin(); it != taxname.end(); it++)
+		sg.getTaxa()->AddTaxonLabel(NxsString(it->c_str()));
+	if (order.empty())
+		return;
+
+	split_pos.resize(split_weights.size(), -1);
+	for (size_t i = 0; i < order.size(); i++)
+		split_pos[order[i]] = i;
+	sg.resize(order.size(), NULL);
+	out_sg = &sg;
+	remaining = order.size();
+	scanTrees(infile, burnin, max_count, 2);
+	out_sg = NULL;
+	ASSERT(remaining == 0);
+}
+
+TreeFingerprintSet::TreeFingerprintSet() {
+	split_start.push_back(0);
+	weight_threshold = -1000;
+}
+
+inline bool fingerprintLess(const SplitFingerprint &a, const SplitFingerprint &b) {
+	return a.lo < b.lo || (a.lo == b.lo && a.hi < b.hi);
+}
+
+inline bool fingerprintPairLess(const pair<SplitFingerprint, unsigned char> &a,
+		const pair<SplitFingerprint, unsigned char> &b) {
+	return fingerprintLess(a.first, b.first);
+}
+
+SplitFingerprint TreeFingerprintSet::traverseSplits(int &ntaxa, bool &has_first, Node *node, Node *dad) {
+	SplitFingerprint fp = {0, 0};
+	ntaxa = 0;
+	has_first = false;
+	bool has_child = false;
+	int nall = taxname.size();
+	FOR_NEIGHBOR_IT(node, dad, it) {
+		int child_ntaxa;
+		bool child_first;
+		SplitFingerprint child_fp = traverseSplits(child_ntaxa, child_first, (*it)->node, node);
+		fp ^= child_fp;
+		ntaxa += child_ntaxa;
+		has_first |= child_first;
+		has_child = true;
+		if (node->degree() == 2 || child_ntaxa <= 1 || child_ntaxa >= nall - 1)
+			continue;
+		// make sure that taxon 0 is included, like MTreeSet::computeRFDist()
+		if (!child_first)
+			child_fp ^= all_key;
+		splits.push_back(child_fp);
+		split_counted.push_back((*it)->length >= weight_threshold);
+	}
+	if (!has_child) {
+		fp = taxon_keys[node->id];
+		ntaxa = 1;
+		has_first = (node->id == 0);
+	}
+	return fp;
+}
+
+bool TreeFingerprintSet::processTree(MTree *tree, int tree_id, int pass) {
+	assignTaxonIDs(tree);
+	size_t start = split_start.back();
+	int ntaxa;
+	bool has_first;
+	traverseSplits(ntaxa, has_first, tree->root);
+
+	// sort the splits of this tree together with their flags
+	size_t nsplits = splits.size() - start;
+	vector<pair<SplitFingerprint, unsigned char> > tree_splits(nsplits);
+	for (size_t i = 0; i < nsplits; i++)
+		tree_splits[i] = make_pair(splits[start+i], split_counted[start+i]);
+	sort(tree_splits.begin(), tree_splits.end(), fingerprintPairLess);
+	splits.resize(start);
+	split_counted.resize(start);
+	for (size_t i = 0; i < nsplits; i++) {
+		if (i > 0 && tree_splits[i].first == tree_splits[i-1].first)
+			continue;
+		splits.push_back(tree_splits[i].first);
+		split_counted.push_back(tree_splits[i].second);
+	}
+	split_start.push_back(splits.size());
+	return true;
+}
+
+void TreeFingerprintSet::readTrees(const char *infile, int burnin, int max_count, bool is_rooted,
+		double weight_threshold, TreeFingerprintSet *ref) {
+	this->is_rooted = is_rooted;
+	this->weight_threshold = weight_threshold;
+	if (ref) {
+		taxname = ref->taxname;
+		taxon_keys = ref->taxon_keys;
+		all_key = ref->all_key;
+	}
+	scanTrees(infile, burnin, max_count);
+}
+
+int TreeFingerprintSet::computeRFDist(int i, TreeFingerprintSet &set2, int j) {
+	SplitFingerprint *a = splits.data() + split_start[i], *a_end = splits.data() + split_start[i+1];
+	SplitFingerprint *b = set2.splits.data() + set2.split_start[j], *b_end = set2.splits.data() + set2.split_start[j+1];
+	unsigned char *a_counted = split_counted.data() + split_start[i];
+	unsigned char *b_counted = set2.split_counted.data() + set2.split_start[j];
+	int diff = 0;
+	while (a != a_end && b != b_end) {
+		if (fingerprintLess(*a, *b)) {
+			diff += *a_counted;
+			a++; a_counted++;
+		} else if (fingerprintLess(*b, *a)) {
+			diff += *b_counted;
+			b++; b_counted++;
+		} else {
+			a++; a_counted++;
+			b++; b_counted++;
+		}
+	}
+	for (; a != a_end; a++, a_counted++)
+		diff += *a_counted;
+	for (; b != b_end; b++, b_counted++)
+		diff += *b_counted;
+	return diff;
+}
+
+void TreeFingerprintSet::computeRFDist(int row_start, int row_end, TreeFingerprintSet &set2, int *rfdist) {
+	int ncols = set2.size();
+	#ifdef _OPENMP
+	#pragma omp parallel for schedule(dynamic)
+	#endif
+	for (int i = row_start; i < row_end; i++) {
+		int *row = rfdist + (size_t)(i - row_start) * ncols;
+		for (int j = 0; j < ncols; j++)
+			row[j] = computeRFDist(i, set2, j);
+	}
+}
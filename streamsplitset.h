@@ -0,0 +1,233 @@
+/***************************************************************************
+ *   Copyright (C) 2009-2015 by                                            *
+ *   BUI Quang Minh <minh.bui@univie.ac.at>                                *
+ *   Lam-Tung Nguyen <nltung@gmail.com>                                    *
+ *                                                                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifndef STREAMSPLITSET_H_
+#define STREAMSPLITSET_H_
+
+#include "mtree.h"
+#include "splitgraph.h"
+
+/** 128-bit fingerprint of a split: XOR of the random keys of its taxa */
+struct SplitFingerprint {
+	uint64_t lo, hi;
+
+	bool operator==(const SplitFingerprint &fp) const {
+		return lo == fp.lo && hi == fp.hi;
+	}
+
+	SplitFingerprint &operator^=(const SplitFingerprint &fp) {
+		lo ^= fp.lo;
+		hi ^= fp.hi;
+		return *this;
+	}
+};
+
+/**
+ * Reads a NEWICK tree file one tree at a time. Leaf IDs of every tree are
+ * assigned by the sorted taxon names of the first tree, like
+ * MTreeSet::checkConsistency(), and every taxon gets a random 128-bit key,
+ * so that the fingerprint of a split is the XOR of the keys of its taxa.
+ */
+class TreeStream {
+public:
+
+	TreeStream();
+
+	virtual ~TreeStream() {}
+
+	/** @return number of taxa */
+	int getNTaxa() { return taxname.size(); }
+
+protected:
+
+	/**
+	 * read all trees of a file and call processTree() for each of them
+	 * @param infile tree file in NEWICK format
+	 * @param burnin number of beginning trees to discard
+	 * @param max_count maximum number of trees to read
+	 * @param pass pass number handed to processTree(), messages are only printed for pass 1
+	 * @return number of trees read
+	 */
+	int scanTrees(const char *infile, int burnin, int max_count, int pass = 1);
+
+	/**
+	 * process one tree of the file
+	 * @return FALSE if no further tree is needed
+	 */
+	virtual bool processTree(MTree *tree, int tree_id, int pass) = 0;
+
+	/** assign leaf IDs by sorted taxon names, the first tree defines the taxa */
+	void assignTaxonIDs(MTree *tree);
+
+	/** sorted taxon names of the first tree */
+	vector<string> taxname;
+
+	/** random keys of the taxa */
+	vector<SplitFingerprint> taxon_keys;
+
+	/** XOR of all taxon keys, the fingerprint of the complement of a split is fp ^ all_key */
+	SplitFingerprint all_key;
+
+	/** TRUE to read the trees as rooted */
+	bool is_rooted;
+};
+
+/**
+ * Split frequencies of a tree file that is too large to be kept in memory.
+ * Trees are read one at a time and every split is identified by its 128-bit
+ * fingerprint, counted in an open-addressing table. Split bitsets are only
+ * built, in a second pass over the file, for the splits that survive the
+ * frequency threshold. The resulting split system is the same, in the same
+ * order, as MTreeSet::convertSplits() with SW_COUNT would give.
+ */
+class StreamSplitSet : public TreeStream {
+public:
+
+	StreamSplitSet();
+
+	/**
+	 * count the splits of all trees in a file
+	 * @param infile tree file in NEWICK format
+	 * @param burnin number of beginning trees to discard
+	 * @param max_count maximum number of trees to read
+	 * @param tree_weight_file file with one integer weight per tree, or NULL
+	 * @param sg[out] split system of the splits with frequency > split_threshold and weight > weight_threshold
+	 * @param split_threshold minimum split frequency, relative to the number of trees
+	 * @param weight_threshold minimum split weight
+	 */
+	void convertSplits(const char *infile, int burnin, int max_count, const char *tree_weight_file,
+			SplitGraph &sg, double split_threshold, double weight_threshold);
+
+	/** @return number of trees read */
+	int size() { return ntrees; }
+
+	/** @return sum of tree weights */
+	int sumTreeWeights();
+
+protected:
+
+	/** pass 1 counts the fingerprints, pass 2 builds the frequent splits */
+	virtual bool processTree(MTree *tree, int tree_id, int pass);
+
+	/**
+	 * traverse the subtree below node in the same order as MTree::convertSplits()
+	 * @param ntaxa[out] number of taxa below node
+	 * @param has_first[out] TRUE if taxon 0 is below node
+	 * @return fingerprint of the taxa below node
+	 */
+	SplitFingerprint traverseSplits(MTree *tree, int weight, int pass, int &ntaxa, bool &has_first,
+			Node *node, Node *dad = NULL);
+
+	/** @return ID of the split with the given fingerprint, inserting a new one if not yet seen */
+	int findOrInsert(const SplitFingerprint &fp);
+
+	/** @return ID of the split with the given fingerprint, or -1 if not seen */
+	int find(const SplitFingerprint &fp);
+
+	/** open-addressing table, fingerprints of the occupied slots */
+	vector<SplitFingerprint> table_keys;
+
+	/** split ID of each slot, -1 for an empty slot */
+	IntVector table_ids;
+
+	/** summed tree weight of every split, indexed by split ID in order of first occurrence */
+	DoubleVector split_weights;
+
+	/** position in the output split system of every split, -1 if discarded */
+	IntVector split_pos;
+
+	/** output split system during the second pass */
+	SplitGraph *out_sg;
+
+	/** number of splits still to be built during the second pass */
+	int remaining;
+
+	/** number of trees read */
+	int ntrees;
+
+	/** tree weights read from file */
+	IntVector tree_weights;
+};
+
+/**
+ * Robinson-Foulds distances of large tree sets. Every tree is reduced to the
+ * sorted array of the fingerprints of its non-trivial splits, oriented to
+ * contain taxon 0, so that the distance between two trees is one merge of two
+ * short arrays. Trivial splits are left out because every tree has all of them.
+ */
+class TreeFingerprintSet : public TreeStream {
+public:
+
+	TreeFingerprintSet();
+
+	/**
+	 * read all trees of a file
+	 * @param infile tree file in NEWICK format
+	 * @param burnin number of beginning trees to discard
+	 * @param max_count maximum number of trees to read
+	 * @param is_rooted TRUE to read the trees as rooted
+	 * @param weight_threshold splits with branch length below this are not counted as different
+	 * @param ref tree set whose taxa the trees must have, or NULL
+	 */
+	void readTrees(const char *infile, int burnin, int max_count, bool is_rooted, double weight_threshold = -1000,
+			TreeFingerprintSet *ref = NULL);
+
+	/** @return number of trees */
+	int size() { return split_start.size() - 1; }
+
+	/**
+	 * @return RF distance between tree i of this set and tree j of set2
+	 */
+	int computeRFDist(int i, TreeFingerprintSet &set2, int j);
+
+	/**
+	 * RF distances between trees [row_start, row_end) of this set and all trees of set2
+	 * @param rfdist[out] (row_end-row_start) x set2.size() matrix
+	 */
+	void computeRFDist(int row_start, int row_end, TreeFingerprintSet &set2, int *rfdist);
+
+protected:
+
+	virtual bool processTree(MTree *tree, int tree_id, int pass);
+
+	/**
+	 * collect the non-trivial splits below node into the current tree
+	 * @param ntaxa[out] number of taxa below node
+	 * @param has_first[out] TRUE if taxon 0 is below node
+	 * @return fingerprint of the taxa below node
+	 */
+	SplitFingerprint traverseSplits(int &ntaxa, bool &has_first, Node *node, Node *dad = NULL);
+
+	/** fingerprints of all trees, sorted within each tree */
+	vector<SplitFingerprint> splits;
+
+	/** 1 if the branch length of the split is at least weight_threshold */
+	vector<unsigned char> split_counted;
+
+	/** start of the splits of every tree in splits, with one extra entry at the end */
+	vector<size_t> split_start;
+
+	/** minimum branch length of a split to be counted as different */
+	double weight_threshold;
+};
+
+#endif /* STREAMSPLITSET_H_ */
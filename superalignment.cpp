@@ -546,22 +546,32 @@ double SuperAlignment::computeMissingData() {
 }
 
 Alignment *SuperAlignment::concatenateAlignments(IntVector &ids) {
-	string union_taxa;
-	int nsites = 0, nstates = 0, i;
-	SeqType sub_type = SEQ_UNKNOWN;
-	for (i = 0; i < ids.size(); i++) {
+	vector<Alignment*> alns;
+	StrVector taxa_sets;
+	for (int i = 0; i < ids.size(); i++) {
 		int id = ids[i];
 		if (id < 0 || id >= partitions.size())
 			outError("Internal error ", __func__);
-		if (nstates == 0) nstates = partitions[id]->num_states;
-		if (sub_type == SEQ_UNKNOWN) sub_type = partitions[id]->seq_type;
-		if (sub_type != partitions[id]->seq_type)
+		alns.push_back(partitions[id]);
+		taxa_sets.push_back(getPattern(id));
+	}
+	string union_taxa;
+	return concatenateAlignments(alns, taxa_sets, union_taxa);
+}
+
+Alignment *SuperAlignment::concatenateAlignments(vector<Alignment*> &alns, StrVector &taxa_sets, string &union_taxa) {
+	int nsites = 0, nstates = 0, i;
+	SeqType sub_type = SEQ_UNKNOWN;
+	for (i = 0; i < alns.size(); i++) {
+		if (nstates == 0) nstates = alns[i]->num_states;
+		if (sub_type == SEQ_UNKNOWN) sub_type = alns[i]->seq_type;
+		if (sub_type != alns[i]->seq_type)
 			outError("Cannot concatenate sub-alignments of different type");
-		if (nstates != partitions[id]->num_states)
+		if (nstates != alns[i]->num_states)
 			outError("Cannot concatenate sub-alignments of different #states");
 
-		string taxa_set = getPattern(id);
-		nsites += partitions[id]->getNSite();
+		string &taxa_set = taxa_sets[i];
+		nsites += alns[i]->getNSite();
 		if (i == 0) union_taxa = taxa_set; else {
 			for (int j = 0; j < union_taxa.length(); j++)
 				if (taxa_set[j] == 1) union_taxa[j] = 1;
@@ -578,14 +588,13 @@ Alignment *SuperAlignment::concatenateAlignments(IntVector &ids) {
 	aln->site_pattern.resize(nsites, -1);
     aln->clear();
     aln->pattern_index.clear();
-    aln->STATE_UNKNOWN = partitions[ids[0]]->STATE_UNKNOWN;
-    aln->genetic_code = partitions[ids[0]]->genetic_code;
+    aln->STATE_UNKNOWN = alns[0]->STATE_UNKNOWN;
+    aln->genetic_code = alns[0]->genetic_code;
 
     int site = 0;
-    for (i = 0; i < ids.size(); i++) {
-    	int id = ids[i];
-		string taxa_set = getPattern(id);
-    	for (Alignment::iterator it = partitions[id]->begin(); it != partitions[id]->end(); it++) {
+    for (i = 0; i < alns.size(); i++) {
+		string &taxa_set = taxa_sets[i];
+    	for (Alignment::iterator it = alns[i]->begin(); it != alns[i]->end(); it++) {
     		Pattern pat;
     		int part_seq = 0;
     		for (int seq = 0; seq < union_taxa.size(); seq++)
@@ -596,10 +605,10 @@ Alignment *SuperAlignment::concatenateAlignments(IntVector &ids) {
     				}
     				pat.push_back(ch);
     			}
-    		assert(part_seq == partitions[id]->getNSeq());
+    		assert(part_seq == alns[i]->getNSeq());
     		aln->addPattern(pat, site, (*it).frequency);
     		// IMPORTANT BUG FIX FOLLOW
-    		int ptnindex = aln->pattern_index[pat];
+    		int ptnindex = aln->site_pattern[site];
             for (int j = 0; j < (*it).frequency; j++)
                 aln->site_pattern[site++] = ptnindex;
 
@@ -632,16 +641,18 @@ void SuperAlignment::countConstSite() {
 
 void SuperAlignment::orderPatternByNumChars() {
     const int UINT_BITS = sizeof(UINT)*8;
-    int maxi = (num_informative_sites+UINT_BITS-1)/UINT_BITS;
-    pars_lower_bound = new UINT[maxi+1];
-    memset(pars_lower_bound, 0, (maxi+1)*sizeof(UINT));
     int part, nseq = getNSeq(), npart = partitions.size();
     
     // compute ordered_pattern
     ordered_pattern.clear();
+    pars_site_weight.clear();
+    num_parsimony_sites = 0;
     UINT sum_scores[npart];
     for (part  = 0; part != partitions.size(); part++) {
         partitions[part]->orderPatternByNumChars();
+        // every partition is padded to PARS_BLOCK_BITS, so the layouts simply concatenate
+        num_parsimony_sites += partitions[part]->num_parsimony_sites;
+        pars_site_weight.insert(pars_site_weight.end(), partitions[part]->pars_site_weight.begin(), partitions[part]->pars_site_weight.end());
         // partial_partition
         for (vector<Pattern>::iterator pit = partitions[part]->ordered_pattern.begin(); pit != partitions[part]->ordered_pattern.end(); pit++) {
             Pattern pattern(*pit);
@@ -655,5 +666,10 @@ void SuperAlignment::orderPatternByNumChars() {
         }
         sum_scores[part] = partitions[part]->pars_lower_bound[0];
     }
+    int maxi = num_parsimony_sites/UINT_BITS;
+    if (pars_lower_bound)
+        delete [] pars_lower_bound;
+    pars_lower_bound = new UINT[maxi+1];
+    memset(pars_lower_bound, 0, (maxi+1)*sizeof(UINT));
     // TODO compute pars_lower_bound (lower bound of pars score for remaining patterns)
 }
@@ -251,6 +251,17 @@ public:
 	 */
     Alignment *concatenateAlignments(IntVector &ids);
 
+	/**
+	 * concatenate alignments of disjoint subsets of partitions. Patterns that occur in several
+	 * alignments are merged, so the work is proportional to the number of patterns of the input
+	 * alignments, e.g. two subsets merged before rather than all their partitions.
+	 * @param alns partitions or alignments returned by concatenateAlignments()
+	 * @param taxa_sets for every alignment, 1 for the taxa of this super alignment it contains
+	 * @param union_taxa (OUT) taxa of the concatenated alignment, in the same format
+	 * @return concatenated alignment
+	 */
+    Alignment *concatenateAlignments(vector<Alignment*> &alns, StrVector &taxa_sets, string &union_taxa);
+
 
 };
 
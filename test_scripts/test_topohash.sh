@@ -0,0 +1,63 @@
+#!/bin/bash -
+#===============================================================================
+#
+#          FILE: test_topohash.sh
+#
+#         USAGE: ./test_topohash.sh <iqtree_binary> [<seeds>]
+#
+#   DESCRIPTION: Check that stopping NNI searches at already visited topologies
+#                does not change the result: every alignment of test_data is
+#                analysed with and without -notopohash for the same seed, and
+#                the final trees must have the same topology and log-likelihood.
+#
+#       OPTIONS: <seeds> number of random seeds per alignment (default: 3)
+#  REQUIREMENTS: ---
+#          BUGS: ---
+#         NOTES: ---
+#       CREATED: 2026-10-19
+#      REVISION:  ---
+#===============================================================================
+
+set -o nounset                              # Treat unset variables as an error
+
+if [ "$#" -lt 1 ]
+then
+    echo "USAGE: $0 <iqtree_binary> [<seeds>]" >&2
+    exit 1
+fi
+
+binary=$1
+seeds=${2:-3}
+outDir=$(mktemp -d)
+failed=0
+
+for aln in test_data/*.phy
+do
+    name=$(basename ${aln} .phy)
+    for seed in $(seq 1 ${seeds})
+    do
+        for flag in "" "-notopohash"
+        do
+            ${binary} -s ${aln} -seed ${seed} -pre ${outDir}/${name}${flag} -redo -quiet ${flag} > /dev/null 2>&1
+            if [ $? -ne 0 ]; then
+                echo "ERROR: ${binary} -s ${aln} -seed ${seed} ${flag} failed"
+                failed=1
+                continue 2
+            fi
+        done
+        lh=$(grep "Log-likelihood of the tree" ${outDir}/${name}.iqtree | awk '{print $5}')
+        lhNoHash=$(grep "Log-likelihood of the tree" ${outDir}/${name}-notopohash.iqtree | awk '{print $5}')
+        ${binary} -rf ${outDir}/${name}.treefile ${outDir}/${name}-notopohash.treefile -pre ${outDir}/${name}.rf > /dev/null 2>&1
+        rf=$(tail -n 1 ${outDir}/${name}.rf.rfdist | awk '{print $2}')
+        if [ "${rf}" != "0" ] || awk -v a=${lh} -v b=${lhNoHash} 'BEGIN { d = a - b; exit !(d > 0.01 || d < -0.01) }'
+        then
+            echo "ERROR: ${aln} seed ${seed}: log-likelihood ${lh} vs ${lhNoHash} with -notopohash, RF distance ${rf}"
+            failed=1
+        else
+            echo "OK: ${aln} seed ${seed}: log-likelihood ${lh}"
+        fi
+    done
+done
+
+rm -rf ${outDir}
+exit ${failed}
@@ -106,6 +106,8 @@ int TinaTree::computeParsimonyScore() {
 
 void TinaTree::initializeAllPartialLh() {
     int index, indexlh;
+    if (aln->ordered_pattern.empty())
+        aln->orderPatternByNumChars();
     initializeAllPartialLh(index, indexlh);
     assert(index == (nodeNum - 1)*2);
 }
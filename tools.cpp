@@ -726,6 +726,7 @@ void parseArg(int argc, char *argv[], Params &params) {
     params.topotest_replicates = 0;
     params.do_weighted_test = false;
     params.do_au_test = false;
+    params.eval_server = false;
     params.siteLL_file = NULL; //added by MA
     params.partition_file = NULL;
     params.partition_type = 0;
@@ -772,6 +773,8 @@ void parseArg(int argc, char *argv[], Params &params) {
     params.model_test_again = false;
     params.model_test_and_tree = 0;
     params.model_test_separate_rate = false;
+    params.model_test_prune = false;
+    params.model_test_concurrent = false;
     params.optimize_mixmodel_weight = false;
     params.optimize_rate_matrix = false;
     params.store_trans_matrix = false;
@@ -865,6 +868,7 @@ void parseArg(int argc, char *argv[], Params &params) {
     params.step_iterations = 100;
 //    params.store_candidate_trees = false;
 	params.print_ufboot_trees = 0;
+    params.ufboot_weight_storage = BWS_UINT16;
     params.contree_rfdist = -1;
     //const double INF_NNI_CUTOFF = -1000000.0;
     params.nni_cutoff = -1000000.0;
@@ -893,6 +897,13 @@ void parseArg(int argc, char *argv[], Params &params) {
 //    params.autostop = true; // turn on auto stopping rule by default now
     params.unsuccess_iteration = 100;
     params.speednni = true; // turn on reduced hill-climbing NNI by default now
+    params.nni_topo_hash = true;
+    params.fast_search_ncat = 0;
+    params.time_budget = 0.0;
+    // the budget counts from program start, like the wall-clock limit of a job scheduler
+    params.time_budget_start = getRealTime();
+    params.analysis_budget_start = params.time_budget_start;
+    params.analysis_budget = 0.0;
     params.numInitTrees = 100;
     params.fixStableSplits = false;
     params.stableSplitThreshold = 0.9;
@@ -1563,6 +1574,12 @@ void parseArg(int argc, char *argv[], Params &params) {
 				params.do_au_test = true;
 				continue;
 			}
+			if (strcmp(argv[cnt], "-zserve") == 0) {
+				params.eval_server = true;
+				// user trees contain all taxa
+				params.ignore_identical_seqs = false;
+				continue;
+			}
 			if (strcmp(argv[cnt], "-sp") == 0) {
 				cnt++;
 				if (cnt >= argc)
@@ -1839,6 +1856,14 @@ void parseArg(int argc, char *argv[], Params &params) {
 				params.model_test_separate_rate = true;
 				continue;
 			}
+			if (strcmp(argv[cnt], "-mprune") == 0) {
+				params.model_test_prune = true;
+				continue;
+			}
+			if (strcmp(argv[cnt], "-mgroup") == 0) {
+				params.model_test_concurrent = true;
+				continue;
+			}
 			if (strcmp(argv[cnt], "-mwopt") == 0) {
 				params.optimize_mixmodel_weight = true;
 				continue;
@@ -2577,6 +2602,20 @@ void parseArg(int argc, char *argv[], Params &params) {
 				params.print_ufboot_trees = 2;
 				continue;
 			}
+			if (strcmp(argv[cnt], "-bbw") == 0) {
+				cnt++;
+				if (cnt >= argc)
+					throw "Use -bbw u16|u8|seed";
+				if (strcmp(argv[cnt], "u16") == 0)
+					params.ufboot_weight_storage = BWS_UINT16;
+				else if (strcmp(argv[cnt], "u8") == 0)
+					params.ufboot_weight_storage = BWS_UINT8;
+				else if (strcmp(argv[cnt], "seed") == 0)
+					params.ufboot_weight_storage = BWS_SEED;
+				else
+					throw "Use -bbw u16|u8|seed";
+				continue;
+			}
 			if (strcmp(argv[cnt], "-bs") == 0) {
 				cnt++;
 				if (cnt >= argc)
@@ -2850,6 +2889,29 @@ void parseArg(int argc, char *argv[], Params &params) {
 				params.speednni = false;
 				continue;
 			}
+			if (strcmp(argv[cnt], "-notopohash") == 0) {
+				params.nni_topo_hash = false;
+				continue;
+			}
+			if (strcmp(argv[cnt], "-fastcat") == 0) {
+				cnt++;
+				if (cnt >= argc)
+					throw "Use -fastcat <number_of_categories>";
+				params.fast_search_ncat = convert_int(argv[cnt]);
+				if (params.fast_search_ncat < 1)
+					throw "-fastcat must be positive";
+				continue;
+			}
+			if (strcmp(argv[cnt], "-deadline") == 0) {
+				cnt++;
+				if (cnt >= argc)
+					throw "Use -deadline <time_in_minutes>";
+				params.time_budget = convert_double(argv[cnt]) * 60;
+				if (params.time_budget <= 0)
+					throw "-deadline must be positive";
+				params.analysis_budget = params.time_budget;
+				continue;
+			}
             
 			if (strcmp(argv[cnt], "-snni") == 0) {
 				params.snni = true;
@@ -3359,6 +3421,9 @@ void usage_iqtree(char* argv[], bool full_command) {
             << "  -pers <proportion>   Perturbation strength for randomized NNI (default: 0.5)" << endl
             << "  -sprrad <number>     Radius for parsimony SPR search (default: 6)" << endl
             << "  -allnni              Perform more thorough NNI search (default: off)" << endl
+            << "  -notopohash          Do not stop NNI search at already visited topologies" << endl
+            << "  -fastcat <#cat>      Use <#cat> Gamma categories until the topology stabilises" << endl
+            << "  -deadline <minutes>  Wall-clock limit from program start for the whole run" << endl
             << "  -g <constraint_tree> (Multifurcating) topological constraint tree file" << endl
 //            << "  -iqp                 Use the IQP tree perturbation (default: randomized NNI)" << endl
 //            << "  -iqpnni              Switch back to the old IQPNNI tree search algorithm" << endl
@@ -3371,6 +3436,8 @@ void usage_iqtree(char* argv[], bool full_command) {
 			<< "  -nstep <#iterations> #Iterations for UFBoot stopping rule (default: 100)" << endl
             << "  -bcor <min_corr>     Minimum correlation coefficient (default: 0.99)" << endl
 			<< "  -beps <epsilon>      RELL epsilon to break tie (default: 0.5)" << endl
+            << "  -bbw u16|u8|seed     Store replicate weights as 16-bit or 8-bit counts, or" << endl
+            << "                       regenerate them from a seed to save RAM (default: u16)" << endl
             << endl << "STANDARD NON-PARAMETRIC BOOTSTRAP:" << endl
             << "  -b <#replicates>     Bootstrap + ML tree + consensus tree (>=100)" << endl
             << "  -bc <#replicates>    Bootstrap + consensus tree" << endl
@@ -3407,6 +3474,8 @@ void usage_iqtree(char* argv[], bool full_command) {
 //            << "  -msep                Perform model selection and then rate selection" << endl
             << "  -mtree               Performing full tree search for each model considered" << endl
             << "  -mredo               Ignoring model results computed earlier (default: no)" << endl
+            << "  -mprune              Skip models nested in a tested model if they cannot win" << endl
+            << "  -mgroup              Test groups of models concurrently with -nt > 1" << endl
             << "  -madd mx1,...,mxk    List of mixture models to also consider" << endl
             << "  -mdef <nexus_file>   A model definition NEXUS file (see Manual)" << endl
 
@@ -3492,6 +3561,9 @@ void usage_iqtree(char* argv[], bool full_command) {
             << "  -zb <#replicates>    Performing BP,KH,SH,ELW tests for trees passed via -z" << endl
             << "  -zw                  Also performing weighted-KH and weighted-SH tests" << endl
             << "  -au                  Also performing approximately unbiased (AU) test" << endl
+            << "  -zserve              Keep the model loaded and score trees read from stdin" << endl
+            << "                       (one Newick tree per line, results on stdout; use" << endl
+            << "                       -quiet to keep the analysis log off stdout)" << endl
 //            << endl << "ANCESTRAL SEQUENCE RECONSTRUCTION:" << endl
 //            << "  -asr                 Compute ancestral states by marginal reconstruction" << endl
 //            << "  -asr-min <prob>      Min probability to assign ancestral sequence (default: 0.95)" << endl
@@ -3801,6 +3873,16 @@ int finish_random() {
 
 int *randstream;
 
+/** stream of the calling thread set by set_thread_random(), NULL for the global randstream */
+static int *thread_randstream = NULL;
+#ifdef _OPENMP
+#pragma omp threadprivate(thread_randstream)
+#endif
+
+void set_thread_random(int *rstream) {
+    thread_randstream = rstream;
+}
+
 int init_random(int seed, bool write_info, int** rstream) {
     //    srand((unsigned) time(NULL));
     if (seed < 0)
@@ -3865,6 +3947,8 @@ double random_double(int *rstream) {
 #elif RAN_TYPE == RAN_SPRNG
     if (rstream)
         return sprng(rstream);
+    else if (thread_randstream)
+        return sprng(thread_randstream);
     else
         return sprng(randstream);
 #else /* NO_SPRNG */
@@ -3874,6 +3958,8 @@ double random_double(int *rstream) {
 #if RAN_TYPE == RAN_SPRNG
     if (rstream)
         return sprng(rstream);
+    else if (thread_randstream)
+        return sprng(thread_randstream);
     else
         return sprng(randstream);
 #else /* NO_SPRNG */
@@ -445,6 +445,11 @@ enum AncestralSeqType {
     AST_NONE, AST_MARGINAL, AST_JOINT
 };
 
+/** storage of UFBoot replicate weights: 16-bit or 8-bit counts, or only a seed per replicate */
+enum BootWeightStorage {
+    BWS_UINT16, BWS_UINT8, BWS_SEED
+};
+
 const int BRLEN_OPTIMIZE = 0; // optimize branch lengths
 const int BRLEN_FIX      = 1; // fix branch lengths
 const int BRLEN_SCALE    = 2; // scale branch lengths
@@ -607,6 +612,37 @@ public:
 	 */
 	bool speednni;
 
+	/**
+	 *  stop an NNI search once it reaches a topology already known to be NNI-optimal
+	 */
+	bool nni_topo_hash;
+
+	/**
+	 *  number of Gamma rate categories used in the early search iterations (0: off).
+	 *  The full model is restored once the stable splits of the candidate set do not grow anymore
+	 */
+	int fast_search_ncat;
+
+	/**
+	 *  hard wall-clock budget of the whole run in seconds (0: off), set by -deadline
+	 */
+	double time_budget;
+
+	/**
+	 *  real time when the time budget started, i.e. when the command line was parsed,
+	 *  so the budget also covers reading the input and the model selection.
+	 *  A resumed run moves it back by the time used before the interruption.
+	 */
+	double time_budget_start;
+
+	/**
+	 *  real time when the current analysis started and its share of time_budget in seconds.
+	 *  Standard bootstrap splits the rest of the budget over the replicates and the analysis
+	 *  of the original alignment, otherwise the whole run is one analysis.
+	 */
+	double analysis_budget_start;
+	double analysis_budget;
+
 
 	/**
 	 *  portion of NNI used for perturbing the tree
@@ -769,6 +805,12 @@ public:
     /** true to do the approximately unbiased (AU) test */
     bool do_au_test;
 
+    /**
+     * true to keep the fitted model resident after the analysis and score trees
+     * read from stdin, one Newick tree per line, until end of input
+     */
+    bool eval_server;
+
     /**
             file specifying partition model
      */
@@ -1259,6 +1301,18 @@ public:
     /** true to fist test equal rate model, then test rate heterogeneity (default: false) */
     bool model_test_separate_rate;
 
+    /**
+        true to skip the optimization of a candidate model whose log-likelihood is bounded by an already
+        evaluated model nesting it, if the bound cannot beat the best information criteria (default: false)
+    */
+    bool model_test_prune;
+
+    /**
+        true to evaluate groups of candidate models concurrently on copies of the tree when running
+        with several threads, results then depend on the number of threads (default: false)
+    */
+    bool model_test_concurrent;
+
     /** TRUE to optimize mixture model weights */
     bool optimize_mixmodel_weight;
 
@@ -1723,6 +1777,9 @@ public:
 	/** true to print all UFBoot trees to a file */
 	int print_ufboot_trees;
 
+    /** storage of UFBoot replicate weights, see BootWeightStorage */
+    BootWeightStorage ufboot_weight_storage;
+
     int contree_rfdist;
 
     /****** variables for NNI cutoff heuristics ******/
@@ -2294,6 +2351,13 @@ int init_random(int seed, bool write_info = false, int** rstream = NULL);
  */
 int finish_random(int *rstream = NULL);
 
+/**
+ * draw the random numbers of the calling thread from rstream instead of the global randstream,
+ * so that threads running independent tasks give reproducible results
+ * @param rstream stream created by init_random(), NULL to use the global randstream again
+ */
+void set_thread_random(int *rstream);
+
 /**
  * returns a random integer in the range [0; n - 1]
  * @param n upper-bound of random number